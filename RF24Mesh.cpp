@@ -1,3 +1,16 @@
+/* C++ Includes */
+#include <climits>
+#include <cstring>
+
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+#include <cstdio>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 /* Hardware Driver Includes */
 #include <Chimera/chimera.hpp>
 
@@ -10,743 +23,4124 @@ using namespace Chimera;
 
 namespace RF24Mesh
 {
-}
+    static constexpr uint8_t toType(const MessageType type)
+    {
+        return static_cast<uint8_t>(type);
+    }
+
+    /* Send queue classes, serviced lowest first: mesh control, acked user types, unacked user types */
+    static constexpr uint8_t PRIORITY_CONTROL = 0;
+    static constexpr uint8_t PRIORITY_ACKED = 1;
+    static constexpr uint8_t PRIORITY_UNACKED = 2;
+
+    static constexpr uint8_t priorityOf(const uint8_t type)
+    {
+        return (type >= MESH_USER_TYPES) ? PRIORITY_CONTROL : ((type >= MESH_ACKED_TYPES) ? PRIORITY_ACKED : PRIORITY_UNACKED);
+    }
+
+    const char *traceEventName(const TraceEvent event)
+    {
+        static const char *const names[] = { "POLL_SENT",       "POLL_HEARD",      "REQUEST_SENT",  "REQUEST_RECEIVED", "OFFER_SENT",
+                                             "OFFER_RECEIVED",  "OFFER_EXPIRED",   "CONFIRM_SENT",  "CONFIRM_RECEIVED", "LOOKUP_SENT",
+                                             "LOOKUP_ANSWERED", "LOOKUP_FAILED",   "LOOKUP_SERVED", "RELEASE_SENT",     "RELEASE_RECEIVED",
+                                             "RENEWAL_DONE",    "RENEWAL_FAILED" };
+
+        const uint8_t index = static_cast<uint8_t>(event);
+        return (index < sizeof(names) / sizeof(names[0])) ? names[index] : "UNKNOWN";
+    }
+
+    static_assert(sizeof(RF24Network::Header) + MESH_FRAME_PAYLOAD_SIZE <= sizeof(RF24Network::Network::frame_buffer), "MESH_FRAME_PAYLOAD_SIZE does not fit the network frame");
+
+    template<typename Role>
+    BasicMesh<Role>::BasicMesh(NRF24L::NRF24L01 &radio, RF24Network::Network &network) : network(network), radio(radio)
+    {
+        mesh_address = MESH_DEFAULT_ADDRESS;
+        addrListTop = 0;
+        addressList = nullptr;
+        dhcp->addrListCapacity = 0;
+        dhcp->userAddressStorage = false;
+        localTableSequence = 0;
+        tableSequence = &localTableSequence;
+        tableWriters = 0;
+
+        doDHCP = false;
+        nodeID = 0;
+        radio_channel = MESH_DEFAULT_CHANNEL;
+        memset(offers, 0, sizeof(offers));
+        lastSaveTime = 0;
+        dhcp->lastFileSave = 0;
+
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+        dhcp->journalFd = -1;
+        dhcp->journalSequence = 0;
+        dhcp->journalRecords = 0;
+        dhcp->journalDirty = false;
+        dhcp->dhcpMap = nullptr;
+        dhcp->dhcpMapSize = 0;
+#endif
+
+        frameSequence = 0;
+        dispatch = nullptr;
+        batchSequence = 0;
+        idLookupSequence = 0;
+
+        memset(proxied, 0, sizeof(proxied));
+        parentLookupMisses = 0;
+        memset(subscribers, 0, sizeof(subscribers));
+        subscriberCount = 0;
+        pendingDeltaCount = 0;
+        deltaSequence = 0;
+        subscribed = false;
+        deltaSynced = false;
+        lastSubscribe = 0;
+
+        standby = false;
+        syncing = false;
+        lastMasterContact = 0;
+        lastStandbyCheck = 0;
+        promotionCallback = nullptr;
+
+        memset(sendQueue, 0, sizeof(sendQueue));
+        memset(&queueLookup, 0, sizeof(queueLookup));
+        jitterState = 0x9E3779B9;
+        memset(&*bulkOut, 0, sizeof(*bulkOut));
+        bulkOut->address = -1;
+        memset(&*bulkIn, 0, sizeof(*bulkIn));
+        bulkIn->from = MESH_DEFAULT_ADDRESS;
+
+        lastAddress = MESH_DEFAULT_ADDRESS;
+        lastChannel = MESH_DEFAULT_CHANNEL;
+        memset(&channelSwitch, 0, sizeof(channelSwitch));
+        memset(&probe, 0, sizeof(probe));
+
+        leaseRenewed = 0;
+        leaseSent = 0;
+        dhcp->leaseCursor = 0;
+
+        allocationPolicy = nullptr;
+        hintedParent = MESH_DEFAULT_ADDRESS;
+
+        memset(mailbox, 0, sizeof(mailbox));
+        memset(sleepers, 0, sizeof(sleepers));
+        inboxHead = 0;
+        inboxCount = 0;
+
+        clearAddressCache();
+        rebuildIndex();
+        memset(&renewal, 0, sizeof(renewal));
+        renewal.state = RenewalState::IDLE;
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::begin(const uint8_t channel, const DataRate data_rate, const uint32_t timeout)
+    {
+        radio.begin();
+        radio_channel = channel;
+        radio.setChannel(radio_channel);
+        radio.setDataRate(data_rate);
+        network.returnSysMsgs = 1;
+
+        if (!isMaster())
+        {
+            //Not master node
+#if !defined(RF24_TINY) && !defined(MESH_NOMASTER)
+            if (Role::master && standby)
+            {
+                allocateAddressPool();
+                beginTableWrite();
+                addrListTop = 0;
+                rebuildIndex();
+                endTableWrite();
+            }
+#endif
+            mesh_address = MESH_DEFAULT_ADDRESS;
+            if (!Role::routing)
+            {
+                setChild(false);
+            }
+            if (!renewAddress(timeout))
+            {
+                return 0;
+            }
+        }
+        else
+        {
+#if !defined(RF24_TINY) && !defined(MESH_NOMASTER)
+            allocateAddressPool();
+            beginTableWrite();
+            addrListTop = 0;
+            rebuildIndex();
+            endTableWrite();
+            loadDHCP();
+#endif
+            mesh_address = 0;
+            network.begin(mesh_address);
+        }
+
+        return 1;
+    }
+
+#if !defined(RF24_TINY) && !defined(MESH_NOMASTER)
+    template<typename Role>
+    void BasicMesh<Role>::allocateAddressPool()
+    {
+        if (dhcp->userAddressStorage || addressList)
+        {
+            return;
+        }
+
+        if (MESH_STATIC_ADDRESS_POOL)
+        {
+            static AddressList addressPool[MESH_ADDRESS_POOL_SIZE];
+            addressList = addressPool;
+        }
+        else
+        {
+            addressList = (AddressList *)malloc(MESH_ADDRESS_POOL_SIZE * sizeof(AddressList));
+        }
+        dhcp->addrListCapacity = addressList ? MESH_ADDRESS_POOL_SIZE : 0;
+    }
+#endif
+
+    template<typename Role>
+    uint8_t BasicMesh<Role>::update()
+    {
+        uint8_t type = pollNetwork();
+
+        if ((renewal.state != RenewalState::IDLE) && (renewal.state != RenewalState::COMPLETE) && (renewal.state != RenewalState::FAILED))
+        {
+            stepRenewal(type);
+        }
+
+        serviceQueue(type);
+
+        if (probe.active && (millis() - probe.sent > probeTimeout()))
+        {
+            finishProbe(false, 0);
+        }
+
+        if (mesh_address == MESH_DEFAULT_ADDRESS)
+        {
+            return type;
+        }
+
+        serviceBulk(type);
+
+        if (channelSwitch.pending)
+        {
+            serviceChannelSwitch();
+        }
+
+        if (Role::routing)
+        {
+            serviceMailbox(type);
+        }
+
+        if (!isMaster())
+        {
+            if (type == toType(MessageType::MESH_ADDR_CHANGED))
+            {
+                applyDeltas(currentFrame());
+            }
+            else if (type == toType(MessageType::MESH_MAIL_DELIVER))
+            {
+                acceptMail(currentFrame());
+            }
+            else if (type == toType(MessageType::MESH_CHANNEL_SWITCH))
+            {
+                acceptChannelSwitch(currentFrame());
+            }
+            else if ((type == toType(MessageType::MESH_REHOME_HINT)) && (currentFrame().header().from_node == 00))
+            {
+                const FrameView frame = currentFrame();
+                hintedParent = frame.get<uint16_t>();
+            }
+            else if (Role::routing && MESH_LOOKUP_VIA_PARENT && (type == toType(MessageType::MESH_ADDR_LOOKUP)))
+            {
+                relayLookup(currentFrame());
+            }
+
+            if (subscribed && (millis() - lastSubscribe > MESH_SUBSCRIBE_REFRESH))
+            {
+                subscribeAddresses(true);
+            }
+
+            if (MESH_LEASE_TIME)
+            {
+                renewLease(type);
+            }
+
+#if !defined(RF24_TINY) && !defined(MESH_NOMASTER)
+            if (Role::master && standby)
+            {
+                serviceStandby(type);
+            }
+#endif
+        }
+
+#if !defined(RF24_TINY) && !defined(MESH_NOMASTER)
+        if (isMaster())
+        {
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+            syncJournal();
+#endif
+            handleControl(type, currentFrame());
+            reclaimLeases();
+            flushDeltas();
+        }
+#endif
+
+        dispatchFrames();
+        return type;
+    }
+
+#if !defined(RF24_TINY) && !defined(MESH_NOMASTER)
+    template<typename Role>
+    void BasicMesh<Role>::handleControl(const uint8_t type, const FrameView &frame)
+    {
+        //The request types are contiguous, so this compiles to an indexed jump rather than a compare chain
+        switch (type)
+        {
+            case RF24Network::NETWORK_REQ_ADDRESS:
+            {
+                //Answered later from DHCP(), so only the requester needs remembering
+                stats.count(&Stats::dhcpRequests);
+                trace(TraceEvent::REQUEST_RECEIVED, frame.header().from_node, frame.header().reserved);
+                queueOffer(frame.header().reserved, frame.header().from_node, frame);
+                break;
+            }
+
+            case toType(MessageType::MESH_ADDR_LOOKUP):
+            case toType(MessageType::MESH_ID_LOOKUP):
+            {
+                RF24Network::Header header = frame.header();
+                header.to_node = header.from_node;
+
+                stats.count(&Stats::lookupsServed);
+                const bool byID = (type == toType(MessageType::MESH_ADDR_LOOKUP));
+                int16_t returnAddr = byID ? getAddress(frame.get<uint8_t>()) : getNodeID(frame.get<uint16_t>());
+                trace(TraceEvent::LOOKUP_SERVED, header.to_node, byID ? frame.get<uint8_t>() : static_cast<uint8_t>(returnAddr > 0 ? returnAddr : 0));
+                network.write(header, &returnAddr, sizeof(returnAddr));
+                break;
+            }
+
+            case toType(MessageType::MESH_ADDR_LOOKUP_BATCH):
+            {
+                RF24Network::Header header = frame.header();
+                header.to_node = header.from_node;
+
+                //Payload is a count followed by that many nodeIDs, answered in the same order
+                const uint8_t *request = frame.payload();
+                uint8_t count = request[0];
+                if (count > MESH_MAX_BATCH_LOOKUP)
+                {
+                    count = MESH_MAX_BATCH_LOOKUP;
+                }
+
+                int16_t returnAddrs[MESH_MAX_BATCH_LOOKUP];
+                for (uint8_t i = 0; i < count; i++)
+                {
+                    returnAddrs[i] = getAddress(request[1 + i]);
+                }
+                network.write(header, returnAddrs, count * sizeof(int16_t));
+                stats.count(&Stats::lookupsServed, count);
+                break;
+            }
+
+            case toType(MessageType::MESH_ADDR_RELEASE):
+            {
+                uint8_t slot = findAddressSlot(frame.header().from_node);
+
+                if ((slot != MESH_INVALID_SLOT) && !(addressList[slot].flags & MESH_LEASE_RELEASED))
+                {
+                    //Stays indexed so the address isn't handed to anyone else until the hold is over
+                    beginTableWrite();
+                    addressList[slot].flags = MESH_LEASE_RELEASED;
+                    addressList[slot].expires = millis() + MESH_ADDRESS_HOLD_TIME;
+                    endTableWrite();
+                    trace(TraceEvent::RELEASE_RECEIVED, frame.header().from_node, addressList[slot].nodeID);
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+                    journalAddress(addressList[slot].nodeID);
+#endif
+                    notifyAddress(addressList[slot].nodeID, 0);
+                }
+                break;
+            }
+
+            case toType(MessageType::MESH_ADDR_RENEW):
+            {
+                extendLease(frame);
+                break;
+            }
+
+            case toType(MessageType::MESH_ADDR_SUBSCRIBE):
+            {
+                const uint8_t id = frame.get<uint8_t>(0);
+                const uint8_t mask = 1 << (id & 7);
+                const bool wasSubscribed = subscribers[id >> 3] & mask;
+
+                if (!id || (wasSubscribed == (frame.get<uint8_t>(1) != 0)))
+                {
+                    break;
+                }
+
+                subscribers[id >> 3] ^= mask;
+                if (wasSubscribed)
+                {
+                    subscriberCount--;
+                }
+                else
+                {
+                    subscriberCount++;
+                }
+                break;
+            }
+
+            case toType(MessageType::MESH_ADDR_CONFIRM):
+            {
+                confirmOffer(frame.header().from_node);
+                break;
+            }
+
+            case toType(MessageType::MESH_TABLE_SYNC):
+            {
+                sendTableSync(frame.header().from_node, frame.get<uint8_t>(0) != 0);
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::notifyAddress(const uint8_t nodeID, const uint16_t address)
+    {
+        if (!subscriberCount)
+        {
+            return;
+        }
+
+        //Only the latest change per node matters
+        for (uint8_t i = 0; i < pendingDeltaCount; i++)
+        {
+            if (pendingDeltas[i].nodeID == nodeID)
+            {
+                pendingDeltas[i].address = address;
+                return;
+            }
+        }
+
+        if (pendingDeltaCount >= MESH_MAX_DELTAS)
+        {
+            flushDeltas();
+        }
+
+        pendingDeltas[pendingDeltaCount].nodeID = nodeID;
+        pendingDeltas[pendingDeltaCount].address = address;
+        pendingDeltaCount++;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::flushDeltas()
+    {
+        if (!pendingDeltaCount)
+        {
+            return;
+        }
+
+        uint8_t payload[MESH_FRAME_PAYLOAD_SIZE];
+        payload[0] = deltaSequence++;
+        payload[1] = pendingDeltaCount;
+        for (uint8_t i = 0; i < pendingDeltaCount; i++)
+        {
+            payload[2 + (i * 3)] = pendingDeltas[i].nodeID;
+            memcpy(&payload[3 + (i * 3)], &pendingDeltas[i].address, sizeof(uint16_t));
+        }
+        const uint8_t length = 2 + (pendingDeltaCount * 3);
+        pendingDeltaCount = 0;
+
+        for (uint16_t id = 1; id < NodeSlots; id++)
+        {
+            if (!subscribers[id >> 3])
+            {
+                id |= 7;
+                continue;
+            }
+
+            const uint8_t slot = nodeSlot[id];
+            if (!(subscribers[id >> 3] & (1 << (id & 7))) || (slot == MESH_INVALID_SLOT) || (addressList[slot].flags & MESH_LEASE_RELEASED))
+            {
+                continue;
+            }
+
+            RF24Network::Header header(addressList[slot].address, toType(MessageType::MESH_ADDR_CHANGED));
+            network.write(header, payload, length);
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::reclaimLeases()
+    {
+        const uint32_t now = millis();
+
+        for (uint8_t checked = 0; (checked < MESH_RECLAIM_BATCH) && addrListTop; checked++)
+        {
+            if (dhcp->leaseCursor >= addrListTop)
+            {
+                dhcp->leaseCursor = 0;
+            }
+
+            AddressList &entry = addressList[dhcp->leaseCursor];
+            if (!canExpire(entry) || (static_cast<int32_t>(now - entry.expires) < 0))
+            {
+                dhcp->leaseCursor++;
+                continue;
+            }
+
+            if (entry.flags & MESH_LEASE_RELEASED)
+            {
+                //The hold is over. The last entry moves into this slot, so the cursor stays to check it.
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+                const uint8_t id = entry.nodeID;
+                removeAddress(dhcp->leaseCursor);
+                journalAddress(id);
+#else
+                removeAddress(dhcp->leaseCursor);
+#endif
+                continue;
+            }
+
+            //The node stopped renewing. Nobody else gets the address until the hold is over too.
+            beginTableWrite();
+            entry.flags = MESH_LEASE_RELEASED;
+            entry.expires = now + MESH_ADDRESS_HOLD_TIME;
+            endTableWrite();
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+            journalAddress(entry.nodeID);
+#endif
+            notifyAddress(entry.nodeID, 0);
+            dhcp->leaseCursor++;
+        }
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::canExpire(const AddressList &entry)
+    {
+        if (entry.flags & MESH_LEASE_PERMANENT)
+        {
+            return false;
+        }
+        return MESH_LEASE_TIME || (entry.flags & MESH_LEASE_RELEASED);
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::extendLease(const FrameView &frame)
+    {
+        RF24Network::Header header = frame.header();
+        header.to_node = header.from_node;
+
+        const uint8_t slot = nodeSlot[header.reserved];
+        int16_t returnAddr = -1;
+
+        if ((slot != MESH_INVALID_SLOT) && !(addressList[slot].flags & MESH_LEASE_RELEASED) && (addressList[slot].address == header.from_node))
+        {
+            beginTableWrite();
+            addressList[slot].expires = millis() + MESH_LEASE_TIME;
+            endTableWrite();
+            returnAddr = addressList[slot].address;
+        }
+        network.write(header, &returnAddr, sizeof(returnAddr));
+
+        if (returnAddr < 0)
+        {
+            return;
+        }
+
+        //Suggest a move if the node heard a parent that is clearly better than the one it has
+        uint16_t contacts[MESH_MAX_POLLS - 1];
+        const uint8_t count = readContacts(frame, contacts);
+        const int16_t current = parentCost(parentOf(header.to_node), true, header.reserved);
+        uint16_t better = MESH_DEFAULT_ADDRESS;
+        int16_t best = (current < 0) ? INT16_MAX : current - MESH_REHOME_MARGIN;
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            const int16_t cost = parentCost(contacts[i], false, header.reserved);
+            if ((cost >= 0) && (cost < best))
+            {
+                best = cost;
+                better = contacts[i];
+            }
+        }
+
+        if (better != MESH_DEFAULT_ADDRESS)
+        {
+            header.type = toType(MessageType::MESH_REHOME_HINT);
+            network.write(header, &better, sizeof(better));
+        }
+    }
+#endif
+
+    template<typename Role>
+    void BasicMesh<Role>::applyDeltas(const FrameView &frame)
+    {
+        const uint8_t sequence = frame.get<uint8_t>(0);
+        uint8_t count = frame.get<uint8_t>(1);
+        if (count > MESH_MAX_DELTAS)
+        {
+            count = MESH_MAX_DELTAS;
+        }
+
+        //A gap means a change was missed, and any remembered lookup may be the stale one
+        if (deltaSynced && (sequence != deltaSequence))
+        {
+            clearAddressCache();
+        }
+        deltaSequence = sequence + 1;
+        deltaSynced = true;
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            const uint8_t id = frame.get<uint8_t>(2 + (i * 3));
+            const uint16_t address = frame.get<uint16_t>(3 + (i * 3));
+
+#if !defined(RF24_TINY) && !defined(MESH_NOMASTER)
+            if (Role::master && standby && id)
+            {
+                storeAddress(id, address);
+            }
+#endif
+
+            if (!id || (id == getNodeID()))
+            {
+                continue;
+            }
+
+            if (address)
+            {
+                cacheAddress(id, address);
+            }
+            else
+            {
+                invalidateAddress(id);
+            }
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::renewLease(const uint8_t type)
+    {
+        const uint32_t now = millis();
+
+        if (type == toType(MessageType::MESH_ADDR_RENEW))
+        {
+            const FrameView frame = currentFrame();
+            if (frame.header().from_node || (frame.header().reserved != nodeID))
+            {
+                return;
+            }
+
+            if (frame.get<int16_t>() == static_cast<int16_t>(mesh_address))
+            {
+                leaseRenewed = now;
+            }
+            else
+            {
+                //The master no longer has this address down for us, see shouldRenew()
+                probe.addressLost = true;
+            }
+            return;
+        }
+
+        if ((now - leaseRenewed < MESH_LEASE_TIME / 2) || (now - leaseSent < MESH_LEASE_RETRY))
+        {
+            return;
+        }
+        leaseSent = now;
+
+        RF24Network::Header header(00, toType(MessageType::MESH_ADDR_RENEW));
+        header.reserved = nodeID;
+        uint8_t contacts[1 + (2 * (MESH_MAX_POLLS - 1))];
+        network.write(header, contacts, writeContacts(contacts, parentOf(mesh_address)));
+    }
+
+    template<typename Role>
+    uint8_t BasicMesh<Role>::writeContacts(uint8_t *const payload, const uint16_t exclude) const
+    {
+        uint8_t count = 0;
+        for (uint8_t i = 0; (i < renewal.pollCount) && (count < MESH_MAX_POLLS - 1); i++)
+        {
+            if (renewal.contactNode[i] != exclude)
+            {
+                memcpy(&payload[1 + (count * 2)], &renewal.contactNode[i], sizeof(uint16_t));
+                count++;
+            }
+        }
+
+        payload[0] = MESH_CONTACT_MARKER | count;
+        return 1 + (count * 2);
+    }
+
+    template<typename Role>
+    uint8_t BasicMesh<Role>::readContacts(const FrameView &frame, uint16_t *const contacts)
+    {
+        //Older nodes send nothing, and the buffer then holds whatever the last frame left there
+        const uint8_t tag = frame.get<uint8_t>(0);
+        const uint8_t count = tag & ~MESH_CONTACT_MARKER;
+        if (((tag & MESH_CONTACT_MARKER) != MESH_CONTACT_MARKER) || (count > MESH_MAX_POLLS - 1))
+        {
+            return 0;
+        }
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            contacts[i] = frame.get<uint16_t>(1 + (i * 2));
+        }
+        return count;
+    }
+
+#if !defined(RF24_TINY) && !defined(MESH_NOMASTER)
+    template<typename Role>
+    void BasicMesh<Role>::sendTableSync(const uint16_t to, const bool full)
+    {
+        RF24Network::Header header(to, toType(MessageType::MESH_TABLE_SYNC));
+        uint8_t payload[MESH_FRAME_PAYLOAD_SIZE];
+        uint8_t start = 0;
+
+        //A heartbeat is a single frame with no entries, carrying the change sequence the standby should be at
+        do
+        {
+            uint8_t count = 0;
+            while (full && (count < MESH_SYNC_ENTRIES) && ((start + count) < addrListTop))
+            {
+                const AddressList &entry = addressList[start + count];
+                const uint16_t address = (entry.flags & MESH_LEASE_RELEASED) ? 0 : entry.address;
+                payload[4 + (count * 3)] = entry.nodeID;
+                memcpy(&payload[5 + (count * 3)], &address, sizeof(uint16_t));
+                count++;
+            }
+
+            payload[0] = deltaSequence;
+            payload[1] = start;
+            payload[2] = count;
+            payload[3] = full ? addrListTop : 0;
+            network.write(header, payload, 4 + (count * 3));
+            start += count;
+        } while (full && (start < addrListTop));
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::serviceStandby(const uint8_t type)
+    {
+        const uint32_t now = millis();
+
+        if (!lastMasterContact)
+        {
+            //Just joined, so check on the master straight away
+            lastStandbyCheck = now - MESH_STANDBY_INTERVAL;
+            lastMasterContact = now;
+        }
+
+        if ((type == toType(MessageType::MESH_TABLE_SYNC)) || (type == toType(MessageType::MESH_ADDR_CHANGED)))
+        {
+            lastMasterContact = now;
+        }
+
+        if (type == toType(MessageType::MESH_TABLE_SYNC))
+        {
+            const FrameView frame = currentFrame();
+            const uint8_t sequence = frame.get<uint8_t>(0);
+            const uint8_t start = frame.get<uint8_t>(1);
+            uint8_t count = frame.get<uint8_t>(2);
+            const uint8_t total = frame.get<uint8_t>(3);
+
+            if (syncing)
+            {
+                if (count > MESH_SYNC_ENTRIES)
+                {
+                    count = MESH_SYNC_ENTRIES;
+                }
+
+                //A snapshot sees the whole chunk applied or none of it
+                beginTableWrite();
+                if (!start)
+                {
+                    addrListTop = 0;
+                    rebuildIndex();
+                }
+
+                for (uint8_t i = 0; i < count; i++)
+                {
+                    storeAddress(frame.get<uint8_t>(4 + (i * 3)), frame.get<uint16_t>(5 + (i * 3)));
+                }
+                endTableWrite();
+
+                if (start + count >= total)
+                {
+                    syncing = false;
+                    deltaSequence = sequence;
+                    deltaSynced = true;
+                }
+            }
+            else if (deltaSynced && (sequence != deltaSequence))
+            {
+                //A change notification went missing, so the copy can't be trusted any more
+                deltaSynced = false;
+            }
+        }
+
+        if (now - lastStandbyCheck < MESH_STANDBY_INTERVAL)
+        {
+            return;
+        }
+        lastStandbyCheck = now;
+
+        if (now - lastMasterContact > static_cast<uint32_t>(MESH_STANDBY_INTERVAL) * MESH_STANDBY_MISSES)
+        {
+            promote();
+            return;
+        }
+
+        if (!subscribed)
+        {
+            subscribeAddresses(true);
+        }
+
+        //Ask for the whole table until a sync completes, otherwise just check the master is there
+        const uint8_t full = !deltaSynced;
+        syncing = full;
+        RF24Network::Header header(00, toType(MessageType::MESH_TABLE_SYNC));
+        network.write(header, &full, sizeof(full));
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::promote()
+    {
+        const uint8_t previousID = nodeID;
+
+        standby = false;
+        syncing = false;
+        subscribed = false;
+        renewal.state = RenewalState::IDLE;
+        queueLookup.active = false;
+        clearAddressCache();
+
+        //Nodes looking up the standby's old nodeID now find it at 00
+        setNodeID(0);
+        mesh_address = 0;
+        network.begin(mesh_address);
+        setAddress(previousID, 0, true);
+
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+        saveDHCP();
+#endif
+
+        if (promotionCallback)
+        {
+            promotionCallback();
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::setStandby(const bool enable)
+    {
+        standby = Role::master && Role::node && enable;
+        syncing = false;
+        lastMasterContact = 0;
+        lastStandbyCheck = 0;
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::isStandby() const
+    {
+        return standby;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::setPromotionCallback(const PromotionCallback callback)
+    {
+        promotionCallback = callback;
+    }
+#endif
+
+    template<typename Role>
+    bool BasicMesh<Role>::subscribeAddresses(const bool enable)
+    {
+        if ((mesh_address == MESH_DEFAULT_ADDRESS) || !getNodeID())
+        {
+            return false;
+        }
+
+        const uint8_t request[2] = { static_cast<uint8_t>(getNodeID()), enable };
+        RF24Network::Header header(00, toType(MessageType::MESH_ADDR_SUBSCRIBE));
+        lastSubscribe = millis();
+
+        if (!network.write(header, request, sizeof(request)))
+        {
+            return false;
+        }
+
+        if (enable && !subscribed)
+        {
+            deltaSynced = false;
+        }
+        subscribed = enable;
+        return true;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::setDispatchTable(const DispatchTable *const table)
+    {
+        dispatch = table;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::dispatchFrames()
+    {
+        if (!dispatch)
+        {
+            return;
+        }
+
+        //Only the head of the queue is dispatched, so frames the application reads itself keep their order
+        RF24Network::Header header;
+        while (network.available())
+        {
+            network.peek(header);
+            if ((header.type >= MESH_USER_TYPES) || !dispatch->handlers[header.type])
+            {
+                break;
+            }
+
+            uint8_t buffer[sizeof(RF24Network::Header) + MESH_FRAME_PAYLOAD_SIZE] = {};
+            const uint16_t length = network.read(header, buffer + sizeof(RF24Network::Header), MESH_FRAME_PAYLOAD_SIZE);
+            memcpy(buffer, &header, sizeof(header));
+
+            dispatch->handlers[header.type](FrameView(buffer, frameSequence, length));
+        }
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::writeTo(const uint16_t node, const void *const data, const uint8_t msg_type, const size_t size)
+    {
+        if (mesh_address == MESH_DEFAULT_ADDRESS)
+        {
+            return 0;
+        }
+        RF24Network::Header header(node, msg_type);
+        return network.write(header, data, size);
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::write(const void *const data, const uint8_t msg_type, const size_t size, const uint8_t nodeID)
+    {
+        if (mesh_address == MESH_DEFAULT_ADDRESS)
+        {
+            stats.count(&Stats::writes);
+            stats.count(&Stats::writeFailures);
+            return 0;
+        }
+
+        //Only a destination this node can't resolve locally waits on a lookup, sharing the one the send queue uses.
+        //The master knows every address, so sends to or from it never wait. The wait runs update(), so every
+        //other frame is handled as usual and queued writes to other nodes keep going out.
+        const uint32_t start = millis();
+        int16_t address = resolveQueued(nodeID, start);
+        while ((address == -1) && !isMaster())
+        {
+            //Give up straight away if the lookup itself couldn't be sent
+            if (!queueLookup.active || (millis() - start > MESH_LOOKUP_TIMEOUT))
+            {
+                break;
+            }
+            update();
+            address = resolveQueued(nodeID, millis());
+        }
+
+        //One attempt, as with writeTo(). Retrying is left to the caller, or to queueWrite().
+        const bool ok = (address >= 0) && writeTo(address, data, msg_type, size);
+        if (!ok && (address > 0) && !isMaster())
+        {
+            //The node may have moved, so the next write looks it up again
+            invalidateAddress(nodeID);
+            if (queueLookup.nodeID == nodeID)
+            {
+                queueLookup.answered = false;
+            }
+        }
+
+        stats.count(&Stats::writes);
+        if (!ok)
+        {
+            stats.count(&Stats::writeFailures);
+        }
+        return ok;
+    }
+
+    template<typename Role>
+    SendHandle BasicMesh<Role>::queueWrite(const void *const data, const uint8_t msg_type, const size_t size, const uint8_t nodeID, const uint32_t timeout, const SendCallback callback)
+    {
+        if (size > MESH_FRAME_PAYLOAD_SIZE)
+        {
+            return MESH_INVALID_HANDLE;
+        }
+
+        const uint8_t slot = reserveWrite(msg_type, size, nodeID, timeout, callback);
+        if (slot >= QueueSlots)
+        {
+            return MESH_INVALID_HANDLE;
+        }
+
+        if (size)
+        {
+            memcpy(sendQueue[slot].payload, data, size);
+        }
+        return static_cast<SendHandle>((sendQueue[slot].generation << 8) | slot);
+    }
+
+    template<typename Role>
+    SendStatus BasicMesh<Role>::sendStatus(const SendHandle handle) const
+    {
+        const uint8_t slot = handle & 0xFF;
+        if ((slot >= QueueSlots) || (sendQueue[slot].generation != (handle >> 8)))
+        {
+            return SendStatus::UNKNOWN;
+        }
+        return sendQueue[slot].status;
+    }
+
+    template<typename Role>
+    uint8_t BasicMesh<Role>::reserveWrite(const uint8_t msg_type, const size_t size, const uint8_t nodeID, const uint32_t timeout, const SendCallback callback)
+    {
+        uint8_t slot = 0;
+        while ((slot < QueueSlots) && (sendQueue[slot].status == SendStatus::PENDING))
+        {
+            slot++;
+        }
+
+        if (slot >= QueueSlots)
+        {
+            return QueueSlots;
+        }
+
+        QueuedWrite &entry = sendQueue[slot];
+        const uint32_t now = millis();
+
+        //Generation 0 is never used, which keeps every valid handle distinct from MESH_INVALID_HANDLE
+        if (!++entry.generation)
+        {
+            entry.generation = 1;
+        }
+        entry.status = SendStatus::PENDING;
+        entry.nodeID = nodeID;
+        entry.type = msg_type;
+        entry.length = static_cast<uint16_t>(size);
+        entry.attempts = 0;
+        entry.start = now;
+        entry.timeout = timeout;
+        entry.nextAttempt = now;
+        entry.callback = callback;
+
+        //Seeds the retry jitter differently on each node
+        jitterState ^= now ^ (static_cast<uint32_t>(mesh_address) << 16);
+        if (!jitterState)
+        {
+            jitterState = 1;
+        }
+        return slot;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::serviceLookup(const uint8_t type, const uint32_t now)
+    {
+        //Replies carry the nodeID in the reserved byte (see isLookupReply()), and the queue keeps one lookup in flight at a time
+        if (queueLookup.active)
+        {
+            if ((type == toType(MessageType::MESH_ADDR_LOOKUP)) && isLookupReply(currentFrame(), queueLookup.nodeID))
+            {
+                queueLookup.active = false;
+                queueLookup.answered = true;
+                countParentLookup(true);
+                const FrameView frame = currentFrame();
+                queueLookup.address = frame.get<int16_t>();
+
+                if (queueLookup.address >= 0)
+                {
+                    stats.latency(&Stats::lookupLatency, now - queueLookup.sent);
+                    trace(TraceEvent::LOOKUP_ANSWERED, queueLookup.address, queueLookup.nodeID);
+                    cacheAddress(queueLookup.nodeID, queueLookup.address);
+                }
+                else
+                {
+                    stats.count(&Stats::lookupFailures);
+                    trace(TraceEvent::LOOKUP_FAILED, MESH_DEFAULT_ADDRESS, queueLookup.nodeID);
+                }
+            }
+            else if (now - queueLookup.sent > MESH_ASYNC_LOOKUP_TIMEOUT)
+            {
+                queueLookup.active = false;
+                countParentLookup(false);
+                stats.count(&Stats::lookupFailures);
+                trace(TraceEvent::LOOKUP_FAILED, MESH_DEFAULT_ADDRESS, queueLookup.nodeID);
+
+                for (uint8_t i = 0; i < QueueSlots; i++)
+                {
+                    QueuedWrite &entry = sendQueue[i];
+                    if ((entry.status == SendStatus::PENDING) && (entry.nodeID == queueLookup.nodeID))
+                    {
+                        entry.nextAttempt = now + sendBackoff(++entry.attempts);
+                    }
+                }
+            }
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::serviceQueue(const uint8_t type)
+    {
+        const uint32_t now = millis();
+        serviceLookup(type, now);
+
+        //Without priorities every entry is serviced in the first pass
+        const bool yield = MESH_ENABLE_PRIORITY && controlPending();
+        uint8_t ackedBudget = MESH_ACKED_BUDGET;
+
+        for (uint8_t priority = PRIORITY_CONTROL; priority <= PRIORITY_UNACKED; priority++)
+        {
+            for (uint8_t i = 0; i < QueueSlots; i++)
+            {
+                QueuedWrite &entry = sendQueue[i];
+                if ((entry.status != SendStatus::PENDING) || (MESH_ENABLE_PRIORITY && (priorityOf(entry.type) != priority)))
+                {
+                    continue;
+                }
+
+                if (now - entry.start > entry.timeout)
+                {
+                    completeWrite(i, SendStatus::TIMEOUT);
+                    continue;
+                }
+
+                if ((mesh_address == MESH_DEFAULT_ADDRESS) || (static_cast<int32_t>(now - entry.nextAttempt) < 0))
+                {
+                    continue;
+                }
+
+                if (yield && ((priority == PRIORITY_UNACKED) || ((priority == PRIORITY_ACKED) && !ackedBudget)))
+                {
+                    continue;
+                }
+
+                const int16_t address = resolveQueued(entry.nodeID, now);
+                if (address == -2)
+                {
+                    completeWrite(i, SendStatus::UNKNOWN_NODE);
+                    continue;
+                }
+                else if (address < 0)
+                {
+                    continue;
+                }
+
+                if ((priority == PRIORITY_ACKED) && ackedBudget)
+                {
+                    ackedBudget--;
+                }
+
+                if (writeTo(address, entry.payload, entry.type, entry.length))
+                {
+                    completeWrite(i, SendStatus::SENT);
+                    continue;
+                }
+
+                //The node may have moved, so the next attempt looks it up again
+                if (entry.nodeID)
+                {
+                    invalidateAddress(entry.nodeID);
+                    if (queueLookup.nodeID == entry.nodeID)
+                    {
+                        queueLookup.answered = false;
+                    }
+                }
+                entry.nextAttempt = now + sendBackoff(++entry.attempts);
+            }
+
+            if (!MESH_ENABLE_PRIORITY)
+            {
+                break;
+            }
+        }
+    }
+
+    template<typename Role>
+    int16_t BasicMesh<Role>::resolveQueued(const uint8_t nodeID, const uint32_t now)
+    {
+        if (!nodeID)
+        {
+            return 0;
+        }
+
+#if !defined(RF24_TINY) && !defined(MESH_NOMASTER)
+        if (isMaster())
+        {
+            return getAddress(nodeID);
+        }
+#endif
+
+        const int16_t cached = cachedAddress(nodeID);
+        if (cached >= 0)
+        {
+            stats.count(&Stats::lookupCacheHits);
+            return cached;
+        }
+
+        //Also covers a disabled lookup cache, where the reply is only kept here
+        if (queueLookup.answered && (queueLookup.nodeID == nodeID))
+        {
+            if (queueLookup.address >= 0)
+            {
+                return queueLookup.address;
+            }
+            queueLookup.answered = false;
+            return -2;
+        }
+
+        if (!queueLookup.active)
+        {
+            RF24Network::Header header(lookupTarget(), toType(MessageType::MESH_ADDR_LOOKUP));
+            header.reserved = nodeID;
+            queueLookup.nodeID = nodeID;
+            queueLookup.answered = false;
+            queueLookup.sent = now;
+            queueLookup.active = network.write(header, &queueLookup.nodeID, sizeof(queueLookup.nodeID) + 1);
+            stats.count(&Stats::lookupsSent);
+            trace(TraceEvent::LOOKUP_SENT, header.to_node, nodeID);
+        }
+        return -1;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::completeWrite(const uint8_t slot, const SendStatus status)
+    {
+        QueuedWrite &entry = sendQueue[slot];
+        entry.status = status;
+
+        stats.count(&Stats::writes);
+        if (status != SendStatus::SENT)
+        {
+            stats.count(&Stats::writeFailures);
+        }
+
+        if (entry.callback)
+        {
+            entry.callback(static_cast<SendHandle>((entry.generation << 8) | slot), status);
+        }
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::controlPending() const
+    {
+        if (queueLookup.active)
+        {
+            return true;
+        }
+
+        //Relayed lookups are only expired when the next one arrives, so an old entry stops counting here
+        const uint32_t now = millis();
+        for (const ProxiedLookup &entry : proxied)
+        {
+            if (entry.nodeID && (now - entry.sent <= MESH_ASYNC_LOOKUP_TIMEOUT))
+            {
+                return true;
+            }
+        }
+
+#if !defined(RF24_TINY) && !defined(MESH_NOMASTER)
+        if (isMaster())
+        {
+            for (const Offer &offer : offers)
+            {
+                if (offer.state != OfferState::FREE)
+                {
+                    return true;
+                }
+            }
+        }
+#endif
+        return false;
+    }
+
+    template<typename Role>
+    uint32_t BasicMesh<Role>::sendBackoff(const uint8_t attempts)
+    {
+        const uint8_t shift = (attempts > 5) ? 4 : (attempts ? attempts - 1 : 0);
+        uint32_t delay = static_cast<uint32_t>(MESH_SEND_BACKOFF) << shift;
+        if (delay > MESH_SEND_MAX_BACKOFF)
+        {
+            delay = MESH_SEND_MAX_BACKOFF;
+        }
+
+        //xorshift32, so nodes that failed together don't retry together
+        jitterState ^= jitterState << 13;
+        jitterState ^= jitterState >> 17;
+        jitterState ^= jitterState << 5;
+        return delay + (jitterState % (delay / 2 + 1));
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::beginBulk(const uint8_t nodeID, const void *const data, const size_t size, const uint32_t timeout, const SendCallback callback)
+    {
+        if (!BulkEnabled || (bulkOut->status == SendStatus::PENDING) || !data || !size || (size > MESH_BULK_MAX_SIZE))
+        {
+            return false;
+        }
+
+        const uint32_t now = millis();
+        bulkOut->status = SendStatus::PENDING;
+        bulkOut->id = (bulkOut->id + 1) & ~MESH_BULK_ACK_REQUEST;
+        bulkOut->nodeID = nodeID;
+        bulkOut->address = -1;
+        bulkOut->data = static_cast<const uint8_t *>(data);
+        bulkOut->size = static_cast<uint32_t>(size);
+        bulkOut->fragments = static_cast<uint16_t>((size + MESH_BULK_FRAGMENT - 1) / MESH_BULK_FRAGMENT);
+        bulkOut->base = 0;
+        bulkOut->acked = 0;
+        bulkOut->sent = 0;
+        bulkOut->attempts = 0;
+        bulkOut->start = now;
+        bulkOut->timeout = timeout;
+        bulkOut->nextAttempt = now;
+        bulkOut->lastAck = now;
+        bulkOut->callback = callback;
+        return true;
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::sendBulk(const uint8_t nodeID, const void *const data, const size_t size, const uint32_t timeout)
+    {
+        if (!beginBulk(nodeID, data, size, timeout))
+        {
+            return false;
+        }
+
+        while (bulkOut->status == SendStatus::PENDING)
+        {
+            update();
+        }
+        return bulkOut->status == SendStatus::SENT;
+    }
+
+    template<typename Role>
+    SendStatus BasicMesh<Role>::bulkStatus() const
+    {
+        return bulkOut->status;
+    }
+
+    template<typename Role>
+    uint32_t BasicMesh<Role>::bulkProgress() const
+    {
+        const uint32_t done = static_cast<uint32_t>(bulkOut->base) * MESH_BULK_FRAGMENT;
+        return (done > bulkOut->size) ? bulkOut->size : done;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::setBulkBuffer(void *const buffer, const size_t capacity)
+    {
+        if (!BulkEnabled)
+        {
+            return;
+        }
+
+        bulkIn->buffer = static_cast<uint8_t *>(buffer);
+        bulkIn->capacity = buffer ? static_cast<uint32_t>(capacity) : 0;
+        bulkIn->complete = false;
+        bulkIn->ackPending = false;
+        bulkIn->from = MESH_DEFAULT_ADDRESS;
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::bulkAvailable() const
+    {
+        return bulkIn->complete;
+    }
+
+    template<typename Role>
+    size_t BasicMesh<Role>::readBulk(uint16_t &from)
+    {
+        if (!bulkIn->complete)
+        {
+            return 0;
+        }
+
+        //The sender and id are kept, so resends after a lost final acknowledgement are recognised as this transfer
+        bulkIn->complete = false;
+        from = bulkIn->from;
+        return bulkIn->size;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::serviceBulk(const uint8_t type)
+    {
+        if (!BulkEnabled)
+        {
+            //Turn transfers away straight off, rather than let the sender time out
+            if (type == toType(MessageType::MESH_BULK_DATA))
+            {
+                const FrameView frame = currentFrame();
+                sendBulkAck(frame.header().from_node, frame.get<uint8_t>(0) & ~MESH_BULK_ACK_REQUEST, true);
+            }
+            return;
+        }
+
+        if (type == toType(MessageType::MESH_BULK_DATA))
+        {
+            acceptFragment(currentFrame());
+        }
+        else if (type == toType(MessageType::MESH_BULK_ACK))
+        {
+            acceptBulkAck(currentFrame());
+        }
+
+        const uint32_t now = millis();
+        if (bulkIn->ackPending && (now - bulkIn->lastFragment > MESH_BULK_ACK_DELAY))
+        {
+            sendBulkAck(bulkIn->from, bulkIn->id, false);
+        }
+
+        if (bulkOut->status != SendStatus::PENDING)
+        {
+            return;
+        }
+
+        if (now - bulkOut->start > bulkOut->timeout)
+        {
+            finishBulk(SendStatus::TIMEOUT);
+            return;
+        }
+
+        if (bulkOut->address < 0)
+        {
+            bulkOut->address = resolveQueued(bulkOut->nodeID, now);
+            if (bulkOut->address == -2)
+            {
+                finishBulk(SendStatus::UNKNOWN_NODE);
+                return;
+            }
+            else if (bulkOut->address < 0)
+            {
+                return;
+            }
+        }
+
+        //Either the fragment asking for an acknowledgement or the acknowledgement itself was lost
+        const uint16_t remaining = bulkOut->fragments - bulkOut->base;
+        const uint32_t window = (remaining >= MESH_BULK_WINDOW) ? 0xFFFFFFFFUL >> (32 - MESH_BULK_WINDOW) : (1UL << remaining) - 1;
+        if (((bulkOut->sent & window) == window) && (now - bulkOut->lastAck > MESH_BULK_ACK_TIMEOUT))
+        {
+            uint32_t lost = bulkOut->sent & ~bulkOut->acked;
+            bulkOut->sent = bulkOut->acked;
+            bulkOut->lastAck = now;
+            while (lost)
+            {
+                stats.count(&Stats::bulkResends);
+                lost &= lost - 1;
+            }
+        }
+
+        //Bulk data goes last, after unacked user writes
+        if ((static_cast<int32_t>(now - bulkOut->nextAttempt) >= 0) && !(MESH_ENABLE_PRIORITY && controlPending()))
+        {
+            sendFragments(now);
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::sendFragments(const uint32_t now)
+    {
+        const uint16_t remaining = bulkOut->fragments - bulkOut->base;
+        const uint8_t span = (remaining < MESH_BULK_WINDOW) ? static_cast<uint8_t>(remaining) : MESH_BULK_WINDOW;
+
+        uint8_t burst[MESH_BULK_BURST];
+        uint8_t count = 0;
+        for (uint8_t i = 0; (i < span) && (count < MESH_BULK_BURST); i++)
+        {
+            if (!(bulkOut->sent & (1UL << i)))
+            {
+                burst[count++] = i;
+            }
+        }
+
+        for (uint8_t n = 0; n < count; n++)
+        {
+            const uint16_t index = bulkOut->base + burst[n];
+            const uint32_t offset = static_cast<uint32_t>(index) * MESH_BULK_FRAGMENT;
+            const uint32_t left = bulkOut->size - offset;
+            const uint8_t length = (left < MESH_BULK_FRAGMENT) ? static_cast<uint8_t>(left) : MESH_BULK_FRAGMENT;
+            const bool last = (n + 1 == count);
+
+            uint8_t payload[MESH_FRAME_PAYLOAD_SIZE];
+            payload[0] = bulkOut->id | (last ? MESH_BULK_ACK_REQUEST : 0);
+            payload[1] = index & 0xFF;
+            payload[2] = index >> 8;
+            payload[3] = bulkOut->size & 0xFF;
+            payload[4] = (bulkOut->size >> 8) & 0xFF;
+            payload[5] = (bulkOut->size >> 16) & 0xFF;
+            memcpy(&payload[MESH_BULK_HEADER], bulkOut->data + offset, length);
+
+            RF24Network::Header header(bulkOut->address, toType(MessageType::MESH_BULK_DATA));
+            stats.count(&Stats::bulkFragments);
+            if (!network.write(header, payload, MESH_BULK_HEADER + length))
+            {
+                //The node may have moved, so the next attempt looks it up again
+                if (bulkOut->nodeID)
+                {
+                    invalidateAddress(bulkOut->nodeID);
+                    if (queueLookup.nodeID == bulkOut->nodeID)
+                    {
+                        queueLookup.answered = false;
+                    }
+                    bulkOut->address = -1;
+                }
+                bulkOut->nextAttempt = now + sendBackoff(++bulkOut->attempts);
+                return;
+            }
+
+            bulkOut->attempts = 0;
+            bulkOut->sent |= 1UL << burst[n];
+            if (last)
+            {
+                bulkOut->lastAck = now;
+            }
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::acceptBulkAck(const FrameView &frame)
+    {
+        if ((bulkOut->status != SendStatus::PENDING) || (frame.header().from_node != bulkOut->address) || (frame.get<uint8_t>(0) != bulkOut->id))
+        {
+            return;
+        }
+
+        const uint16_t base = frame.get<uint16_t>(1);
+        if (base == 0xFFFF)
+        {
+            finishBulk(SendStatus::REFUSED);
+            return;
+        }
+
+        if ((base < bulkOut->base) || (base > bulkOut->fragments))
+        {
+            return;
+        }
+
+        //Slide the window up to the receiver's first missing fragment
+        const uint16_t shift = base - bulkOut->base;
+        bulkOut->acked = (shift >= 32) ? 0 : (bulkOut->acked >> shift);
+        bulkOut->sent = (shift >= 32) ? 0 : (bulkOut->sent >> shift);
+        bulkOut->base = base;
+        bulkOut->lastAck = millis();
+
+        if (base == bulkOut->fragments)
+        {
+            finishBulk(SendStatus::SENT);
+            return;
+        }
+
+        //Fragments are relayed in order, so anything older than the newest one received that is still missing was lost
+        const uint32_t received = frame.get<uint32_t>(5);
+        const uint16_t highest = frame.get<uint16_t>(3);
+        bulkOut->acked |= received;
+        if (highest >= base)
+        {
+            const uint16_t span = highest - base + 1;
+            const uint32_t older = (span >= 32) ? 0xFFFFFFFFUL : (1UL << span) - 1;
+            uint32_t lost = bulkOut->sent & older & ~bulkOut->acked;
+            bulkOut->sent &= ~lost;
+            while (lost)
+            {
+                stats.count(&Stats::bulkResends);
+                lost &= lost - 1;
+            }
+        }
+        bulkOut->sent |= bulkOut->acked;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::acceptFragment(const FrameView &frame)
+    {
+        const uint8_t *payload = frame.payload();
+        const uint16_t from = frame.header().from_node;
+        const uint8_t id = payload[0] & ~MESH_BULK_ACK_REQUEST;
+        bool ackNow = payload[0] & MESH_BULK_ACK_REQUEST;
+        const uint16_t index = payload[1] | (payload[2] << 8);
+        const uint32_t size = payload[3] | (static_cast<uint32_t>(payload[4]) << 8) | (static_cast<uint32_t>(payload[5]) << 16);
+        const uint32_t now = millis();
+
+        const bool known = (from == bulkIn->from) && (id == bulkIn->id) && (size == bulkIn->size);
+        if (!known || ((bulkIn->base >= bulkIn->fragments) && !bulkIn->complete && (now - bulkIn->lastFragment > MESH_BULK_IDLE)))
+        {
+            const bool partial = (bulkIn->from != MESH_DEFAULT_ADDRESS) && (bulkIn->base < bulkIn->fragments) && (now - bulkIn->lastFragment < MESH_BULK_IDLE);
+            if (!bulkIn->buffer || !size || (size > bulkIn->capacity) || (size > MESH_BULK_MAX_SIZE) || bulkIn->complete || partial)
+            {
+                sendBulkAck(from, id, true);
+                return;
+            }
+
+            bulkIn->from = from;
+            bulkIn->id = id;
+            bulkIn->size = size;
+            bulkIn->fragments = static_cast<uint16_t>((size + MESH_BULK_FRAGMENT - 1) / MESH_BULK_FRAGMENT);
+            bulkIn->base = 0;
+            bulkIn->highest = 0;
+            bulkIn->received = 0;
+        }
+        bulkIn->lastFragment = now;
+
+        const uint16_t offset = index - bulkIn->base;
+        if ((index >= bulkIn->base) && (index < bulkIn->fragments) && (offset < MESH_BULK_WINDOW) && !(bulkIn->received & (1UL << offset)))
+        {
+            const uint32_t start = static_cast<uint32_t>(index) * MESH_BULK_FRAGMENT;
+            const uint32_t left = bulkIn->size - start;
+            memcpy(bulkIn->buffer + start, &payload[MESH_BULK_HEADER], (left < MESH_BULK_FRAGMENT) ? left : MESH_BULK_FRAGMENT);
+            bulkIn->received |= 1UL << offset;
+
+            if (index > bulkIn->highest)
+            {
+                bulkIn->highest = index;
+            }
+
+            while (bulkIn->received & 1)
+            {
+                bulkIn->received >>= 1;
+                bulkIn->base++;
+            }
+
+            if (bulkIn->base == bulkIn->fragments)
+            {
+                bulkIn->complete = true;
+                ackNow = true;
+            }
+        }
+
+        if (ackNow)
+        {
+            sendBulkAck(from, id, false);
+        }
+        else
+        {
+            bulkIn->ackPending = true;
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::sendBulkAck(const uint16_t to, const uint8_t id, const bool refused)
+    {
+        const uint16_t base = refused ? 0xFFFF : bulkIn->base;
+
+        uint8_t payload[9];
+        payload[0] = id;
+        memcpy(&payload[1], &base, sizeof(base));
+        memcpy(&payload[3], &bulkIn->highest, sizeof(bulkIn->highest));
+        memcpy(&payload[5], &bulkIn->received, sizeof(bulkIn->received));
+
+        RF24Network::Header header(to, toType(MessageType::MESH_BULK_ACK));
+        network.write(header, payload, sizeof(payload));
+        if (!refused)
+        {
+            bulkIn->ackPending = false;
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::finishBulk(const SendStatus status)
+    {
+        bulkOut->status = status;
+        if (bulkOut->callback)
+        {
+            bulkOut->callback(MESH_INVALID_HANDLE, status);
+        }
+    }
+
+    template<typename Role>
+    FrameView BasicMesh<Role>::currentFrame() const
+    {
+        return FrameView(network.frame_buffer, frameSequence);
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::isCurrent(const FrameView &frame) const
+    {
+        return frame.sequence() == frameSequence;
+    }
+
+    template<typename Role>
+    uint8_t BasicMesh<Role>::pollNetwork()
+    {
+        const uint8_t type = network.update();
+        if (type)
+        {
+            frameSequence++;
+
+            //Checked here rather than in update() so a reply arriving during a blocking call still counts
+            if (probe.active && (type == toType(MessageType::MESH_ADDR_LOOKUP)))
+            {
+                const FrameView frame = currentFrame();
+                if ((frame.header().from_node == 00) && (frame.header().reserved == nodeID))
+                {
+                    probe.addressLost = (frame.get<int16_t>() != static_cast<int16_t>(mesh_address));
+                    finishProbe(true, millis() - probe.sent);
+                }
+            }
+        }
+        return type;
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::probeConnection()
+    {
+        if (probe.active || !nodeID || (mesh_address == MESH_DEFAULT_ADDRESS))
+        {
+            return false;
+        }
+
+        RF24Network::Header header(00, toType(MessageType::MESH_ADDR_LOOKUP));
+        header.reserved = nodeID;
+        probe.sent = millis();
+
+        if (!network.write(header, &nodeID, sizeof(nodeID) + 1))
+        {
+            //Not even the first hop took it
+            finishProbe(false, 0);
+            return true;
+        }
+
+        probe.active = true;
+        return true;
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::probePending() const
+    {
+        return probe.active;
+    }
+
+    template<typename Role>
+    uint16_t BasicMesh<Role>::probeTimeout() const
+    {
+        if (!probe.samples)
+        {
+            return MESH_PROBE_MAX_TIMEOUT;
+        }
+
+        const uint32_t timeout = (probe.srtt8 >> 3) + probe.rttvar4;
+        return (timeout < MESH_PROBE_MIN_TIMEOUT) ? MESH_PROBE_MIN_TIMEOUT : (timeout > MESH_PROBE_MAX_TIMEOUT) ? MESH_PROBE_MAX_TIMEOUT : timeout;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::finishProbe(const bool answered, const uint32_t rtt)
+    {
+        probe.active = false;
+
+        //loss = 7/8 loss + 1/8 sample, kept scaled by 8 so small changes aren't rounded away
+        probe.loss256 = probe.loss256 - (probe.loss256 >> 3) + (answered ? 0 : 256);
+
+        if (!answered)
+        {
+            if (probe.consecutiveLosses < UINT8_MAX)
+            {
+                probe.consecutiveLosses++;
+            }
+            return;
+        }
+
+        probe.consecutiveLosses = 0;
+        const uint16_t sample = (rtt > MESH_PROBE_MAX_TIMEOUT) ? MESH_PROBE_MAX_TIMEOUT : rtt;
+
+        if (!probe.samples)
+        {
+            probe.srtt8 = sample << 3;
+            probe.rttvar4 = (sample >> 1) << 2;
+        }
+        else
+        {
+            //rttvar = 3/4 rttvar + 1/4 |srtt - sample|, then srtt = 7/8 srtt + 1/8 sample
+            const int32_t delta = static_cast<int32_t>(probe.srtt8 >> 3) - sample;
+            probe.rttvar4 = probe.rttvar4 - (probe.rttvar4 >> 2) + (delta < 0 ? -delta : delta);
+            probe.srtt8 = probe.srtt8 - (probe.srtt8 >> 3) + sample;
+        }
+
+        if (probe.samples < UINT16_MAX)
+        {
+            probe.samples++;
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::getLinkQuality(LinkQuality &quality) const
+    {
+        quality.srtt = probe.srtt8 >> 3;
+        quality.rttvar = probe.rttvar4 >> 2;
+        quality.timeout = probeTimeout();
+        quality.loss = static_cast<uint8_t>(((probe.loss256 >> 3) * 100) >> 8);
+        quality.consecutiveLosses = probe.consecutiveLosses;
+        quality.samples = probe.samples;
+        quality.addressLost = probe.addressLost;
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::shouldRenew() const
+    {
+        LinkQuality quality;
+        getLinkQuality(quality);
+        return quality.addressLost || (quality.consecutiveLosses >= MESH_PROBE_FAILURES) || (quality.loss > MESH_PROBE_MAX_LOSS);
+    }
+
+    template<typename Role>
+    uint32_t BasicMesh<Role>::getStats(Stats &out) const
+    {
+        return stats.snapshot(out);
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::resetStats()
+    {
+        stats.reset();
+    }
+
+    template<typename Role>
+    uint16_t BasicMesh<Role>::readTrace(TraceRecord *const out, const uint16_t max, uint32_t &cursor) const
+    {
+        return traceRing.read(out, max, cursor);
+    }
+
+    template<typename Role>
+    uint32_t BasicMesh<Role>::traceCount() const
+    {
+        return traceRing.total();
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::trace(const TraceEvent event, const uint16_t address, const uint8_t nodeID)
+    {
+        if (MESH_ENABLE_TRACE)
+        {
+            traceRing.record(millis(), event, address, nodeID);
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::invalidateAddress(const uint8_t nodeID)
+    {
+        for (uint8_t i = 0; i < CacheSlots; i++)
+        {
+            if (addressCache[i].nodeID == nodeID)
+            {
+                addressCache[i].nodeID = 0;
+            }
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::clearAddressCache()
+    {
+        memset(addressCache, 0, sizeof(addressCache));
+    }
+
+    template<typename Role>
+    int16_t BasicMesh<Role>::cachedAddress(const uint8_t nodeID)
+    {
+        for (uint8_t i = 0; i < CacheSlots; i++)
+        {
+            CachedAddress &entry = addressCache[i];
+            if (!nodeID || (entry.nodeID != nodeID))
+            {
+                continue;
+            }
+
+            //Subscribers are told about changes, so their entries don't need to expire
+            if (!subscribed && (millis() - entry.fetched > MESH_LOOKUP_CACHE_TTL))
+            {
+                entry.nodeID = 0;
+                return -1;
+            }
+
+            entry.lastUsed = millis();
+            return entry.address;
+        }
+        return -1;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::cacheAddress(const uint8_t nodeID, const uint16_t address)
+    {
+        if (!CacheSlots || !nodeID)
+        {
+            return;
+        }
+
+        //Reuse the entry for this node if there is one, otherwise an empty or the least recently used entry
+        const uint32_t now = millis();
+        uint8_t victim = 0;
+        for (uint8_t i = 0; i < CacheSlots; i++)
+        {
+            if (addressCache[i].nodeID == nodeID)
+            {
+                victim = i;
+                break;
+            }
+
+            if (!addressCache[i].nodeID)
+            {
+                if (addressCache[victim].nodeID)
+                {
+                    victim = i;
+                }
+            }
+            else if (addressCache[victim].nodeID && ((now - addressCache[i].lastUsed) > (now - addressCache[victim].lastUsed)))
+            {
+                victim = i;
+            }
+        }
+
+        addressCache[victim].nodeID = nodeID;
+        addressCache[victim].address = address;
+        addressCache[victim].fetched = now;
+        addressCache[victim].lastUsed = now;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::setChannel(uint8_t channel)
+    {
+        radio_channel = channel;
+        radio.setChannel(radio_channel);
+        radio.startListening();
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::switchChannel(const uint8_t channel, const uint16_t delay)
+    {
+        if (!isMaster() || !channel || (channel > 127))
+        {
+            return false;
+        }
+
+        //A restarted master may reuse a sequence, which only matters while that switch is still pending on a node
+        const uint32_t now = millis();
+        channelSwitch.pending = true;
+        channelSwitch.sequence++;
+        channelSwitch.channel = channel;
+        channelSwitch.repeats = MESH_SWITCH_REPEATS;
+        channelSwitch.at = now + delay;
+        channelSwitch.nextRepeat = now;
+        return true;
+    }
+
+    template<typename Role>
+    uint8_t BasicMesh<Role>::pendingChannel() const
+    {
+        return channelSwitch.pending ? channelSwitch.channel : 0;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::acceptChannelSwitch(const FrameView &frame)
+    {
+        //Multicasts reach the whole level, so only announcements from the level above are taken
+        if (addressLevel(frame.header().from_node) + 1 != addressLevel(mesh_address))
+        {
+            return;
+        }
+
+        const uint8_t sequence = frame.get<uint8_t>(0);
+        const uint8_t channel = frame.get<uint8_t>(1);
+        if ((channelSwitch.pending && (sequence == channelSwitch.sequence)) || !channel || (channel > 127))
+        {
+            return;
+        }
+
+        const uint32_t now = millis();
+        channelSwitch.pending = true;
+        channelSwitch.sequence = sequence;
+        channelSwitch.channel = channel;
+        channelSwitch.repeats = Role::routing ? MESH_SWITCH_REPEATS : 0;
+        channelSwitch.at = now + frame.get<uint16_t>(2);
+        channelSwitch.nextRepeat = now;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::serviceChannelSwitch()
+    {
+        const uint32_t now = millis();
+        if (static_cast<int32_t>(now - channelSwitch.at) >= 0)
+        {
+            channelSwitch.pending = false;
+            setChannel(channelSwitch.channel);
+            return;
+        }
+
+        const uint8_t level = addressLevel(mesh_address);
+        if (!channelSwitch.repeats || (level >= MESH_MAX_LEVELS) || (static_cast<int32_t>(now - channelSwitch.nextRepeat) < 0))
+        {
+            return;
+        }
+
+        //Sends the time left rather than the deadline, since node clocks aren't synchronised
+        uint8_t payload[4];
+        const uint16_t remaining = static_cast<uint16_t>(channelSwitch.at - now);
+        payload[0] = channelSwitch.sequence;
+        payload[1] = channelSwitch.channel;
+        memcpy(&payload[2], &remaining, sizeof(remaining));
+
+        RF24Network::Header header(0100, toType(MessageType::MESH_CHANNEL_SWITCH));
+        network.multicast(header, payload, sizeof(payload), level + 1);
+        channelSwitch.repeats--;
+        channelSwitch.nextRepeat = now + MESH_SWITCH_INTERVAL;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::setChild(const bool allow)
+    {
+        network.networkFlags = (allow && Role::routing) ? network.networkFlags & ~RF24Network::FLAG_NO_POLL : network.networkFlags | RF24Network::FLAG_NO_POLL;
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::checkConnection()
+    {
+        uint8_t count = 3;
+        bool ok = 0;
+        stats.count(&Stats::connectionChecks);
+        while (count-- && mesh_address != MESH_DEFAULT_ADDRESS)
+        {
+            update();
+            if (radio.rxFifoFull() || (network.networkFlags & 1))
+            {
+                return 1;
+            }
+            RF24Network::Header header(00, RF24Network::NETWORK_PING);
+            ok = network.write(header, 0, 0);
+            if (ok)
+            {
+                break;
+            }
+            delayMilliseconds(103);
+        }
+        if (!ok)
+        {
+            stats.count(&Stats::connectionFailures);
+            radio.stopListening();
+        }
+        return ok;
+    }
+
+    template<typename Role>
+    int16_t BasicMesh<Role>::getAddress(const uint8_t nodeID)
+    {
+#if !defined(RF24_TINY) && !defined(MESH_NOMASTER)
+        if (isMaster())
+        {
+            //Master Node
+            const uint8_t slot = nodeSlot[nodeID];
+            if ((slot != MESH_INVALID_SLOT) && !(addressList[slot].flags & MESH_LEASE_RELEASED))
+            {
+                return addressList[slot].address;
+            }
+            return -1;
+        }
+#endif
+        if (mesh_address == MESH_DEFAULT_ADDRESS)
+        {
+            return -1;
+        }
+        if (!nodeID)
+        {
+            return 0;
+        }
+        //This may swallow the reply to the send queue's lookup, which then has to ask again
+        queueLookup.active = false;
 
-//{
-//    Mesh::Mesh(NRF24L::NRF24L01 &radio, RF24Network::Network &network): radio(radio), network(network)
-//    {
-//
-//    }
-//
-//    bool Mesh::begin(uint8_t channel, DataRate data_rate, uint32_t timeout)
-//    {
-//        radio.begin();
-//        radio_channel = channel;
-//        radio.setChannel(radio_channel);
-//        radio.setDataRate(data_rate);
-//        network.returnSysMsgs = 1;
-//
-//        if (getNodeID())
-//        {
-//            //Not master node
-//            mesh_address = MESH_DEFAULT_ADDRESS;
-//            if (!renewAddress(timeout))
-//            {
-//                return 0;
-//            }
-//        }
-//        else
-//        {
-//#if !defined(RF24_TINY) && !defined(MESH_NOMASTER)
-//            addressList = (AddressList *)malloc(2 * sizeof(AddressList));
-//            addrListTop = 0;
-//            loadDHCP();
-//#endif
-//            mesh_address = 0;
-//            network.begin(mesh_address);
-//        }
-//
-//        return 1;
-//    }
-//
-//    uint8_t Mesh::update()
-//    {
-//        uint8_t type = network.update();
-//        if (mesh_address == MESH_DEFAULT_ADDRESS)
-//        {
-//            return type;
-//        }
-//
-//#if !defined(RF24_TINY) && !defined(MESH_NOMASTER)
-//        if (type == NETWORK_REQ_ADDRESS)
-//        {
-//            doDHCP = 1;
-//        }
-//
-//        if (!getNodeID())
-//        {
-//            if ((type == MESH_ADDR_LOOKUP || type == MESH_ID_LOOKUP))
-//            {
-//                RF24NetworkHeader &header = *(RF24NetworkHeader *)network.frame_buffer;
-//                header.to_node = header.from_node;
-//
-//                if (type == MESH_ADDR_LOOKUP)
-//                {
-//                    int16_t returnAddr = getAddress(network.frame_buffer[sizeof(RF24NetworkHeader)]);
-//                    network.write(header, &returnAddr, sizeof(returnAddr));
-//                }
-//                else
-//                {
-//                    int16_t returnAddr = getNodeID(network.frame_buffer[sizeof(RF24NetworkHeader)]);
-//                    network.write(header, &returnAddr, sizeof(returnAddr));
-//                }
-//                //printf("Returning lookup 0%o to 0%o   \n",returnAddr,header.to_node);
-//                //network.write(header,&returnAddr,sizeof(returnAddr));
-//            }
-//            else if (type == MESH_ADDR_RELEASE)
-//            {
-//                uint16_t *fromAddr = (uint16_t *)network.frame_buffer;
-//                for (uint8_t i = 0; i < addrListTop; i++)
-//                {
-//                    if (addressList[i].address == *fromAddr)
-//                    {
-//                        addressList[i].address = 0;
-//                    }
-//                }
-//            }
-//#if !defined(ARDUINO_ARCH_AVR)
-//            else if (type == MESH_ADDR_CONFIRM)
-//            {
-//                RF24NetworkHeader &header = *(RF24NetworkHeader *)network.frame_buffer;
-//                if (header.from_node == lastAddress)
-//                {
-//                    setAddress(lastID, lastAddress);
-//                }
-//            }
-//#endif
-//        }
-//
-//#endif
-//        return type;
-//    }
-//
-//    bool Mesh::writeTo(uint16_t node, const void *data, uint8_t msg_type, size_t size)
-//    {
-//        if (mesh_address == MESH_DEFAULT_ADDRESS)
-//        {
-//            return 0;
-//        }
-//        RF24NetworkHeader header(node, msg_type);
-//        return network.write(header, data, size);
-//    }
-//
-//    bool Mesh::write(const void *data, uint8_t msg_type, size_t size, uint8_t nodeID)
-//    {
-//        if (mesh_address == MESH_DEFAULT_ADDRESS)
-//        {
-//            return 0;
-//        }
-//
-//        int16_t toNode = 0;
-//        int32_t lookupTimeout = millis() + MESH_LOOKUP_TIMEOUT;
-//        uint32_t retryDelay = 50;
-//
-//        if (nodeID)
-//        {
-//            while ((toNode = getAddress(nodeID)) < 0)
-//            {
-//                if (millis() > lookupTimeout || toNode == -2)
-//                {
-//                    return 0;
-//                }
-//                retryDelay += 50;
-//                delayMilliseconds(retryDelay);
-//            }
-//        }
-//        return writeTo(toNode, data, msg_type, size);
-//    }
-//
-//    void Mesh::setChannel(uint8_t _channel)
-//    {
-//        radio_channel = _channel;
-//        radio.setChannel(radio_channel);
-//        radio.startListening();
-//    }
-//
-//    void Mesh::setChild(bool allow)
-//    {
-////Prevent old versions of RF24Network from throwing an error
-////Note to remove this ""if defined"" after a few releases from 1.0.1
-//#if defined FLAG_NO_POLL
-//        network.networkFlags = allow ? network.networkFlags & ~FLAG_NO_POLL : network.networkFlags | FLAG_NO_POLL;
-//#endif
-//    }
-//
-//    bool Mesh::checkConnection()
-//    {
-//        uint8_t count = 3;
-//        bool ok = 0;
-//        while (count-- && mesh_address != MESH_DEFAULT_ADDRESS)
-//        {
-//            update();
-//            if (radio.rxFifoFull() || (network.networkFlags & 1))
-//            {
-//                return 1;
-//            }
-//            RF24NetworkHeader header(00, NETWORK_PING);
-//            ok = network.write(header, 0, 0);
-//            if (ok)
-//            {
-//                break;
-//            }
-//            delayMilliseconds(103);
-//        }
-//        if (!ok)
-//        {
-//            radio.stopListening();
-//        }
-//        return ok;
-//    }
-//
-//    int16_t Mesh::getAddress(uint8_t nodeID)
-//    {
-////#if defined (ARDUINO_SAM_DUE) || defined (__linux)
-//#if !defined RF24_TINY && !defined(MESH_NOMASTER)
-//        if (!getNodeID())
-//        {
-//            //Master Node
-//            uint16_t address = 0;
-//            for (uint8_t i = 0; i < addrListTop; i++)
-//            {
-//                if (addressList[i].nodeID == nodeID)
-//                {
-//                    address = addressList[i].address;
-//                    return address;
-//                }
-//            }
-//            return -1;
-//        }
-//#endif
-//        if (mesh_address == MESH_DEFAULT_ADDRESS)
-//        {
-//            return -1;
-//        }
-//        if (!nodeID)
-//        {
-//            return 0;
-//        }
-//        RF24NetworkHeader header(00, MESH_ADDR_LOOKUP);
-//        if (network.write(header, &nodeID, sizeof(nodeID) + 1))
-//        {
-//            uint32_t timer = millis(), timeout = 150;
-//            while (network.update() != MESH_ADDR_LOOKUP)
-//            {
-//                if (millis() - timer > timeout)
-//                {
-//                    return -1;
-//                }
-//            }
-//        }
-//        else
-//        {
-//            return -1;
-//        }
-//        int16_t address = 0;
-//        memcpy(&address, network.frame_buffer + sizeof(RF24NetworkHeader), sizeof(address));
-//        return address >= 0 ? address : -2;
-//    }
-//
-//    int16_t Mesh::getNodeID(uint16_t address)
-//    {
-//        if (address == MESH_BLANK_ID)
-//        {
-//            return nodeID;
-//        }
-//        else if (address == 0)
-//        {
-//            return 0;
-//        }
-//
-//        if (!mesh_address)
-//        {
-//            //Master Node
-//            for (uint8_t i = 0; i < addrListTop; i++)
-//            {
-//                if (addressList[i].address == address)
-//                {
-//                    return addressList[i].nodeID;
-//                }
-//            }
-//        }
-//        else
-//        {
-//            if (mesh_address == MESH_DEFAULT_ADDRESS)
-//            {
-//                return -1;
-//            }
-//            RF24NetworkHeader header(00, MESH_ID_LOOKUP);
-//            if (network.write(header, &address, sizeof(address)))
-//            {
-//                uint32_t timer = millis(), timeout = 500;
-//                while (network.update() != MESH_ID_LOOKUP)
-//                {
-//                    if (millis() - timer > timeout)
-//                    {
-//                        return -1;
-//                    }
-//                }
-//                int16_t ID;
-//                memcpy(&ID, &network.frame_buffer[sizeof(RF24NetworkHeader)], sizeof(ID));
-//                return ID;
-//            }
-//        }
-//        return -1;
-//    }
-//
-//    bool Mesh::releaseAddress()
-//    {
-//        if (mesh_address == MESH_DEFAULT_ADDRESS)
-//        {
-//            return 0;
-//        }
-//
-//        RF24NetworkHeader header(00, MESH_ADDR_RELEASE);
-//        if (network.write(header, 0, 0))
-//        {
-//            network.begin(MESH_DEFAULT_ADDRESS);
-//            mesh_address = MESH_DEFAULT_ADDRESS;
-//            return 1;
-//        }
-//        return 0;
-//    }
-//
-//    uint16_t Mesh::renewAddress(uint32_t timeout)
-//    {
-//        if (radio.available())
-//        {
-//            return 0;
-//        }
-//        uint8_t reqCounter = 0;
-//        uint8_t totalReqs = 0;
-//        radio.stopListening();
-//
-//        network.networkFlags |= 2;
-//        delayMilliseconds(10);
-//
-//        network.begin(MESH_DEFAULT_ADDRESS);
-//        mesh_address = MESH_DEFAULT_ADDRESS;
-//
-//        uint32_t start = millis();
-//        while (!requestAddress(reqCounter))
-//        {
-//            if (millis() - start > timeout)
-//            {
-//                return 0;
-//            }
-//            delayMilliseconds(50 + ((totalReqs + 1) * (reqCounter + 1)) * 2);
-//            reqCounter++;
-//            reqCounter = reqCounter % 4;
-//            totalReqs++;
-//            totalReqs = totalReqs % 10;
-//        }
-//        network.networkFlags &= ~2;
-//        return mesh_address;
-//    }
-//
-//    bool Mesh::requestAddress(uint8_t level)
-//    {
-//        RF24NetworkHeader header(0100, NETWORK_POLL);
-////Find another radio, starting with level 0 multicast
-//#if defined(MESH_DEBUG_SERIAL)
-//        Serial.print(millis());
-//        Serial.println(F(" MSH: Poll "));
-//#endif
-//        network.multicast(header, 0, 0, level);
-//
-//        uint32_t timr = millis();
-//#define MESH_MAXPOLLS 4
-//        uint16_t contactNode[MESH_MAXPOLLS];
-//        uint8_t pollCount = 0;
-//
-//        while (1)
-//        {
-//#if defined(MESH_DEBUG_SERIAL) || defined(MESH_DEBUG_PRINTF)
-//            bool goodSignal = radio.testRPD();
-//#endif
-//            if (network.update() == NETWORK_POLL)
-//            {
-//                memcpy(&contactNode[pollCount], &network.frame_buffer[0], sizeof(uint16_t));
-//                ++pollCount;
-//
-//#if defined(MESH_DEBUG_SERIAL) || defined(MESH_DEBUG_PRINTF)
-//                if (goodSignal)
-//                {
-//// This response was better than -64dBm
-//#if defined(MESH_DEBUG_SERIAL)
-//                    Serial.print(millis());
-//                    Serial.println(F(" MSH: Poll > -64dbm "));
-//#elif defined(MESH_DEBUG_PRINTF)
-//                    printf("%u MSH: Poll > -64dbm\n", millis());
-//#endif
-//                }
-//                else
-//                {
-//#if defined(MESH_DEBUG_SERIAL)
-//                    Serial.print(millis());
-//                    Serial.println(F(" MSH: Poll < -64dbm "));
-//#elif defined(MESH_DEBUG_PRINTF)
-//                    printf("%u MSH: Poll < -64dbm\n", millis());
-//#endif
-//                }
-//#endif
-//            }
-//
-//            if ((millis() - timr) > 55 || (pollCount >= MESH_MAXPOLLS))
-//            {
-//                if (!pollCount)
-//                {
-//#if defined(MESH_DEBUG_SERIAL)
-//                    Serial.print(millis());
-//                    Serial.print(F(" MSH: No poll from level "));
-//                    Serial.println(level);
-//#elif defined(MESH_DEBUG_PRINTF)
-//                    printf("%u MSH: No poll from level %d\n", millis(), level);
-//#endif
-//                    return 0;
-//                }
-//                else
-//                {
-//#if defined(MESH_DEBUG_SERIAL)
-//                    Serial.print(millis());
-//                    Serial.println(F(" MSH: Poll OK "));
-//#elif defined(MESH_DEBUG_PRINTF)
-//                    printf("%u MSH: Poll OK\n", millis());
-//#endif
-//                    break;
-//                }
-//            }
-//        }
-//
-//#ifdef MESH_DEBUG_SERIAL
-//        Serial.print(millis());
-//        Serial.print(F(" MSH: Got poll from level "));
-//        Serial.print(level);
-//        Serial.print(F(" count "));
-//        Serial.print(pollCount);
-//        Serial.print(F(" node "));
-//        Serial.println(contactNode[pollCount]); // #ML#
-//#elif defined MESH_DEBUG_PRINTF
-//        printf("%u MSH: Got poll from level %d count %d\n", millis(), level, pollCount);
-//#endif
-//
-//        uint8_t type = 0;
-//        for (uint8_t i = 0; i < pollCount; i++)
-//        {
-//            // Request an address via the contact node
-//            header.type = NETWORK_REQ_ADDRESS;
-//            header.reserved = getNodeID();
-//            header.to_node = contactNode[i];
-//
-//            // Do a direct write (no ack) to the contact node. Include the nodeId and address.
-//            network.write(header, 0, 0, contactNode[i]);
-//#ifdef MESH_DEBUG_SERIAL
-//            Serial.print(millis());
-//            Serial.print(F(" MSH: Req addr from "));
-//            Serial.println(contactNode[i], OCT);
-//#elif defined MESH_DEBUG_PRINTF
-//            printf("%u MSH: Request address from: 0%o\n", millis(), contactNode[i]);
-//#endif
-//
-//            timr = millis();
-//
-//            while (millis() - timr < 225)
-//            {
-//                if ((type = network.update()) == NETWORK_ADDR_RESPONSE)
-//                {
-//                    i = pollCount;
-//                    break;
-//                }
-//            }
-//            delayMilliseconds(5);
-//        }
-//        if (type != NETWORK_ADDR_RESPONSE)
-//        {
-//            return 0;
-//        }
-//
-//#ifdef MESH_DEBUG_SERIAL
-//        uint8_t mask = 7;
-//        char addrs[5] = "    ", count = 3;
-//        uint16_t newAddr;
-//#endif
-//        uint8_t registerAddrCount = 0;
-//
-//        uint16_t newAddress = 0;
-//        memcpy(&newAddress, network.frame_buffer + sizeof(RF24NetworkHeader), sizeof(newAddress));
-//
-//        if (!newAddress || network.frame_buffer[7] != getNodeID())
-//        {
-//#ifdef MESH_DEBUG_SERIAL
-//            Serial.print(millis());
-//            Serial.print(F(" MSH: Attempt Failed "));
-//            Serial.println(network.frame_buffer[7]);
-//            Serial.print("My NodeID ");
-//            Serial.println(getNodeID());
-//#elif defined MESH_DEBUG_PRINTF
-//            printf("%u Response discarded, wrong node 0%o from node 0%o sending node 0%o id %d\n", millis(), newAddress, header.from_node, MESH_DEFAULT_ADDRESS, network.frame_buffer[7]);
-//#endif
-//            return 0;
-//        }
-//#ifdef MESH_DEBUG_SERIAL
-//        Serial.print(millis());
-//        Serial.print(F(" Set address: "));
-//        newAddr = newAddress;
-//        while (newAddr)
-//        {
-//            addrs[count] = (newAddr & mask) + 48; //get the individual Octal numbers, specified in chunks of 3 bits, convert to ASCII by adding 48
-//            newAddr >>= 3;
-//            count--;
-//        }
-//        Serial.println(addrs);
-//#elif defined(MESH_DEBUG_PRINTF)
-//        printf("Set address 0%o rcvd 0%o\n", mesh_address, newAddress);
-//#endif
-//        mesh_address = newAddress;
-//
-//        radio.stopListening();
-//        delayMilliseconds(10);
-//        network.begin(mesh_address);
-//        header.to_node = 00;
-//        header.type = MESH_ADDR_CONFIRM;
-//
-//        while (!network.write(header, 0, 0))
-//        {
-//            if (registerAddrCount++ >= 6)
-//            {
-//                network.begin(MESH_DEFAULT_ADDRESS);
-//                mesh_address = MESH_DEFAULT_ADDRESS;
-//                return 0;
-//            }
-//            delayMilliseconds(3);
-//        }
-//
-//        return 1;
-//    }
-//
-//    void Mesh::setNodeID(uint8_t nodeID)
-//    {
-//        this->nodeID = nodeID;
-//    }
-//
-//    void Mesh::setAddress(uint8_t nodeID, uint16_t address)
-//    {
-//        uint8_t position = addrListTop;
-//
-//        for (uint8_t i = 0; i < addrListTop; i++)
-//        {
-//            if (addressList[i].nodeID == nodeID)
-//            {
-//                position = i;
-//                break;
-//            }
-//        }
-//        addressList[position].nodeID = nodeID;
-//        addressList[position].address = address;
-//
-//        if (position == addrListTop)
-//        {
-//            ++addrListTop;
-//            addressList = (AddressList *)realloc(addressList, (addrListTop + 1) * sizeof(AddressList));
-//        }
-//
-//#if defined(__linux) && !defined(__ARDUINO_X86__)
-//        //if(millis()-lastFileSave > 300){
-//        //	lastFileSave = millis();
-//        saveDHCP();
-//        //}
-//#endif
-//    }
-//
-//    void Mesh::loadDHCP()
-//    {
-//#if defined(__linux) && !defined(__ARDUINO_X86__)
-//        std::ifstream infile("dhcplist.txt", std::ifstream::binary);
-//        if (!infile)
-//        {
-//            return;
-//        }
-//
-//        addrList[addrListTop].nodeID = 255;
-//        addrList[addrListTop].address = 01114;
-//
-//        infile.seekg(0, infile.end);
-//        int length = infile.tellg();
-//        infile.seekg(0, infile.beg);
-//
-//        addrList = (addrListStruct *)realloc(addrList, length + sizeof(addrListStruct));
-//
-//        addrListTop = length / sizeof(addrListStruct);
-//        for (int i = 0; i < addrListTop; i++)
-//        {
-//            infile.read((char *)&addrList[i], sizeof(addrListStruct));
-//        }
-//        infile.close();
-//#endif
-//    }
-//
-//    void Mesh::saveDHCP()
-//    {
-//#if defined(__linux) && !defined(__ARDUINO_X86__)
-//        std::ofstream outfile("dhcplist.txt", std::ofstream::binary | std::ofstream::trunc);
-//
-//        //printf("writingToFile %d  0%o size %d\n",addrList[0].nodeID,addrList[0].address,sizeof(addrListStruct));
-//
-//        for (int i = 0; i < addrListTop; i++)
-//        {
-//            outfile.write((char *)&addrList[i], sizeof(addrListStruct));
-//        }
-//        outfile.close();
-//
-//        /*addrListStruct aList;
-//	std::ifstream infile ("dhcplist.txt",std::ifstream::binary);
-//	infile.seekg(0,infile.end);
-//	int length = infile.tellg();
-//	infile.seekg(0,infile.beg);
-//	//addrList = (addrListStruct*)malloc(length);
-//
-//	//infile.read( (char*)&addrList,length);
-//	infile.read( (char*)&aList,sizeof(addrListStruct));
-//	 //addrListTop = length/sizeof(addrListStruct);
-//	//for(int i=0; i< addrListTop; i++){
-//	printf("ID: %d  ADDR: 0%o  \n",aList.nodeID,aList.address);
-//	//}
-//	infile.close();*/
-//#endif
-//    }
-//
-//    void Mesh::DHCP()
-//    {
-//        if (doDHCP)
-//        {
-//            doDHCP = 0;
-//        }
-//        else
-//        {
-//            return;
-//        }
-//        RF24NetworkHeader header;
-//        memcpy(&header, network.frame_buffer, sizeof(RF24NetworkHeader));
-//
-//        uint16_t newAddress;
-//
-//        // Get the unique id of the requester
-//        uint8_t from_id = header.reserved;
-//        if (!from_id)
-//        {
-//#ifdef MESH_DEBUG_PRINTF
-//            printf("MSH: Invalid id 0 rcvd\n");
-//#endif
-//            return;
-//        }
-//
-//        uint16_t fwd_by = 0;
-//        uint8_t shiftVal = 0;
-//        bool extraChild = 0;
-//
-//        if (header.from_node != MESH_DEFAULT_ADDRESS)
-//        {
-//            fwd_by = header.from_node;
-//            uint16_t m = fwd_by;
-//            uint8_t count = 0;
-//
-//            while (m)
-//            {
-//                //Octal addresses convert nicely to binary in threes. Address 03 = B011  Address 033 = B011011
-//                m >>= 3; //Find out how many digits are in the octal address
-//                count++;
-//            }
-//            shiftVal = count * 3; //Now we know how many bits to shift when adding a child node 1-5 (B001 to B101) to any address
-//        }
-//        else
-//        {
-//            //If request is coming from level 1, add an extra child to the master
-//            extraChild = 1;
-//        }
-//
-//#ifdef MESH_DEBUG_PRINTF
-////  printf("%u MSH: Rcv addr req from_id %d \n",millis(),from_id);
-//#endif
-//
-//        for (int i = MESH_MAX_CHILDREN + extraChild; i > 0; i--)
-//        {
-//            // For each of the possible addresses (5 max)
-//
-//            bool found = 0;
-//            newAddress = fwd_by | (i << shiftVal);
-//            if (!newAddress)
-//            {
-//                /*printf("dumped 0%o\n",newAddress);*/
-//                continue;
-//            }
-//
-//            for (uint8_t i = 0; i < addrListTop; i++)
-//            {
-//#if defined(MESH_DEBUG_MINIMAL)
-//#if !defined(__linux) && !defined ARDUINO_SAM_DUE || defined TEENSY || defined(__ARDUINO_X86__)
-//                Serial.print("ID: ");
-//                Serial.print(addrList[i].nodeID, DEC);
-//                Serial.print(" ADDR: ");
-//                uint16_t newAddr = addrList[i].address;
-//                char addr[5] = "    ", count = 3, mask = 7;
-//                while (newAddr)
-//                {
-//                    addr[count] = (newAddr & mask) + 48; //get the individual Octal numbers, specified in chunks of 3 bits, convert to ASCII by adding 48
-//                    newAddr >>= 3;
-//                    count--;
-//                }
-//                Serial.println(addr);
-//#else
-//                printf("ID: %d ADDR: 0%o\n", addrList[i].nodeID, addrList[i].address);
-//#endif
-//#endif
-//                if ((addressList[i].address == newAddress && addressList[i].nodeID != from_id) || newAddress == MESH_DEFAULT_ADDRESS)
-//                {
-//                    found = 1;
-//                    break;
-//                }
-//            }
-//
-//            if (!found)
-//            {
-//                header.type = NETWORK_ADDR_RESPONSE;
-//                header.to_node = header.from_node;
-//                //This is a routed request to 00
-//                delayMilliseconds(10); // ML: without this delayMilliseconds, address renewal fails
-//                if (header.from_node != MESH_DEFAULT_ADDRESS)
-//                {
-//                    //Is NOT node 01 to 05
-//                    delayMilliseconds(2);
-//                    if (network.write(header, &newAddress, sizeof(newAddress)))
-//                    {
-//                        //addrMap[from_id] = newAddress; //????
-//                    }
-//                    else
-//                    {
-//                        network.write(header, &newAddress, sizeof(newAddress));
-//                    }
-//                }
-//                else
-//                {
-//                    delayMilliseconds(2);
-//                    network.write(header, &newAddress, sizeof(newAddress), header.to_node);
-//                    //addrMap[from_id] = newAddress;
-//                }
-//                uint32_t timer = millis();
-//                lastAddress = newAddress;
-//                lastID = from_id;
-//                while (network.update() != MESH_ADDR_CONFIRM)
-//                {
-//                    if (millis() - timer > network.routeTimeout)
-//                    {
-//                        return;
-//                    }
-//                }
-//                setAddress(from_id, newAddress);
-//#ifdef MESH_DEBUG_PRINTF
-//                printf("Sent to 0%o phys: 0%o new: 0%o id: %d\n", header.to_node, MESH_DEFAULT_ADDRESS, newAddress, header.reserved);
-//#endif
-//                break;
-//            }
-//            else
-//            {
-//#if defined(MESH_DEBUG_PRINTF)
-//                printf("not allocated\n");
-//#endif
-//            }
-//        }
-//
-//        //}else{
-//        //break;
-//        //}
-//    }
-//}
+        stats.count(&Stats::lookupsSent);
+        uint32_t timer = millis(), timeout = 150;
+
+        RF24Network::Header header(lookupTarget(), toType(MessageType::MESH_ADDR_LOOKUP));
+        header.reserved = nodeID;
+        trace(TraceEvent::LOOKUP_SENT, header.to_node, nodeID);
+        if (network.write(header, &nodeID, sizeof(nodeID) + 1))
+        {
+            while ((pollNetwork() != toType(MessageType::MESH_ADDR_LOOKUP)) || !isLookupReply(currentFrame(), nodeID))
+            {
+                if (millis() - timer > timeout)
+                {
+                    countParentLookup(false);
+                    stats.count(&Stats::lookupFailures);
+                    trace(TraceEvent::LOOKUP_FAILED, MESH_DEFAULT_ADDRESS, nodeID);
+                    return -1;
+                }
+            }
+            countParentLookup(true);
+        }
+        else
+        {
+            stats.count(&Stats::lookupFailures);
+            trace(TraceEvent::LOOKUP_FAILED, MESH_DEFAULT_ADDRESS, nodeID);
+            return -1;
+        }
+        const FrameView reply = currentFrame();
+        const int16_t address = reply.get<int16_t>();
+        if (address < 0)
+        {
+            stats.count(&Stats::lookupFailures);
+            trace(TraceEvent::LOOKUP_FAILED, MESH_DEFAULT_ADDRESS, nodeID);
+            return -2;
+        }
+        stats.latency(&Stats::lookupLatency, millis() - timer);
+        trace(TraceEvent::LOOKUP_ANSWERED, address, nodeID);
+        return address;
+    }
+
+    template<typename Role>
+    uint16_t BasicMesh<Role>::lookupTarget() const
+    {
+        if (!MESH_LOOKUP_VIA_PARENT || (parentLookupMisses >= MESH_PARENT_LOOKUP_MISSES))
+        {
+            return 00;
+        }
+
+        return parentOf(mesh_address);
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::countParentLookup(const bool answered)
+    {
+        if (lookupTarget() == 00)
+        {
+            //Asking the master already, or the parent is the master
+            return;
+        }
+
+        if (answered)
+        {
+            parentLookupMisses = 0;
+        }
+        else
+        {
+            parentLookupMisses++;
+        }
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::isLookupReply(const FrameView &frame, const uint8_t nodeID) const
+    {
+        return (frame.header().from_node == lookupTarget()) && (frame.header().reserved == nodeID);
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::relayLookup(const FrameView &frame)
+    {
+        const RF24Network::Header &received = frame.header();
+        const uint32_t now = millis();
+
+        if (received.from_node == lookupTarget())
+        {
+            //A reply from further up, pass it to every child waiting on that node
+            countParentLookup(true);
+            const int16_t address = frame.get<int16_t>();
+            if (address >= 0)
+            {
+                cacheAddress(received.reserved, address);
+            }
+
+            for (uint8_t i = 0; i < ProxySlots; i++)
+            {
+                if (proxied[i].nodeID && (proxied[i].nodeID == received.reserved))
+                {
+                    RF24Network::Header header(proxied[i].requester, toType(MessageType::MESH_ADDR_LOOKUP));
+                    header.reserved = proxied[i].nodeID;
+                    network.write(header, &address, sizeof(address));
+                    proxied[i].nodeID = 0;
+                }
+            }
+            return;
+        }
+
+        if (network.networkFlags & RF24Network::FLAG_NO_POLL)
+        {
+            //Not a routing node, so no child should be asking
+            return;
+        }
+
+        const uint8_t id = frame.get<uint8_t>();
+        if (!id)
+        {
+            return;
+        }
+
+        int16_t address = (id == getNodeID()) ? mesh_address : cachedAddress(id);
+
+        if (address >= 0)
+        {
+            RF24Network::Header header(received.from_node, toType(MessageType::MESH_ADDR_LOOKUP));
+            header.reserved = id;
+            stats.count(&Stats::lookupsServed);
+            trace(TraceEvent::LOOKUP_SERVED, received.from_node, id);
+            network.write(header, &address, sizeof(address));
+            return;
+        }
+
+        //Stay subscribed while answering for others, so a moved node doesn't get served from a stale entry
+        if (!subscribed)
+        {
+            subscribeAddresses(true);
+        }
+
+        bool asked = false, expired = false;
+        ProxiedLookup *slot = nullptr;
+        for (uint8_t i = 0; i < ProxySlots; i++)
+        {
+            if (proxied[i].nodeID && (now - proxied[i].sent > MESH_ASYNC_LOOKUP_TIMEOUT))
+            {
+                proxied[i].nodeID = 0;
+                expired = true;
+            }
+
+            if (proxied[i].nodeID == id)
+            {
+                asked = true;
+            }
+
+            if (!slot && !proxied[i].nodeID)
+            {
+                slot = &proxied[i];
+            }
+        }
+
+        if (expired)
+        {
+            countParentLookup(false);
+        }
+
+        if (!slot)
+        {
+            //The child will time out and ask again
+            return;
+        }
+
+        slot->nodeID = id;
+        slot->requester = received.from_node;
+        slot->sent = now;
+
+        if (!asked)
+        {
+            RF24Network::Header header(lookupTarget(), toType(MessageType::MESH_ADDR_LOOKUP));
+            header.reserved = id;
+            stats.count(&Stats::lookupsSent);
+            trace(TraceEvent::LOOKUP_SENT, header.to_node, id);
+            network.write(header, &id, sizeof(id) + 1);
+        }
+    }
+
+    template<typename Role>
+    size_t BasicMesh<Role>::getAddresses(const uint8_t *const ids, const size_t n, int16_t *const out)
+    {
+        size_t resolved = 0;
+        uint8_t request[1 + MESH_MAX_BATCH_LOOKUP];
+        uint8_t pending[MESH_MAX_BATCH_LOOKUP]; /**< Position in out of each ID in the request */
+        uint8_t count = 0;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            //The master, unassigned nodes and cache hits need no radio traffic
+            if (!ids[i])
+            {
+                out[i] = 0;
+            }
+            else if (isMaster())
+            {
+                out[i] = getAddress(ids[i]);
+            }
+            else if (mesh_address == MESH_DEFAULT_ADDRESS)
+            {
+                out[i] = -1;
+            }
+            else if ((out[i] = cachedAddress(ids[i])) < 0)
+            {
+                pending[count] = i;
+                request[1 + count] = ids[i];
+                count++;
+            }
+            resolved += (out[i] >= 0);
+
+            if (!count || ((count < MESH_MAX_BATCH_LOOKUP) && (i + 1 < n)))
+            {
+                continue;
+            }
+
+            request[0] = count;
+            stats.count(&Stats::lookupsSent);
+            uint32_t timer = millis(), timeout = 150;
+
+            //The master echoes the header, so the sequence ties the reply to this request and not one that timed out
+            RF24Network::Header header(00, toType(MessageType::MESH_ADDR_LOOKUP_BATCH));
+            header.reserved = ++batchSequence;
+            if (network.write(header, request, 1 + count))
+            {
+                bool answered = false;
+                while (!answered && (millis() - timer <= timeout))
+                {
+                    if (pollNetwork() == toType(MessageType::MESH_ADDR_LOOKUP_BATCH))
+                    {
+                        const FrameView reply = currentFrame();
+                        answered = (reply.header().from_node == 00) && (reply.header().reserved == batchSequence);
+                    }
+                }
+
+                if (!answered)
+                {
+                    stats.count(&Stats::lookupFailures, count);
+                }
+                else
+                {
+                    stats.latency(&Stats::lookupLatency, millis() - timer);
+                    const FrameView reply = currentFrame();
+                    for (uint8_t j = 0; j < count; j++)
+                    {
+                        const int16_t address = reply.get<int16_t>(j * sizeof(int16_t));
+                        out[pending[j]] = address;
+
+                        if (address >= 0)
+                        {
+                            cacheAddress(request[1 + j], address);
+                            trace(TraceEvent::LOOKUP_ANSWERED, address, request[1 + j]);
+                            resolved++;
+                        }
+                        else
+                        {
+                            stats.count(&Stats::lookupFailures);
+                            trace(TraceEvent::LOOKUP_FAILED, MESH_DEFAULT_ADDRESS, request[1 + j]);
+                        }
+                    }
+                }
+            }
+            else
+            {
+                stats.count(&Stats::lookupFailures, count);
+            }
+            count = 0;
+        }
+
+        return resolved;
+    }
+
+    template<typename Role>
+    int16_t BasicMesh<Role>::getNodeID(const uint16_t address)
+    {
+        if (address == MESH_BLANK_ID)
+        {
+            return nodeID;
+        }
+        else if (address == 0)
+        {
+            return 0;
+        }
+
+        if (Role::master && !mesh_address)
+        {
+            //Master Node
+            const uint8_t slot = findAddressSlot(address);
+            if ((slot != MESH_INVALID_SLOT) && !(addressList[slot].flags & MESH_LEASE_RELEASED))
+            {
+                return addressList[slot].nodeID;
+            }
+        }
+        else
+        {
+            if (mesh_address == MESH_DEFAULT_ADDRESS)
+            {
+                return -1;
+            }
+            //The master echoes the header, so the sequence ties the reply to this request and not one that timed out
+            RF24Network::Header header(00, toType(MessageType::MESH_ID_LOOKUP));
+            header.reserved = ++idLookupSequence;
+            if (network.write(header, &address, sizeof(address)))
+            {
+                //Waiting through update() keeps other mesh traffic handled, which pollNetwork() alone would skip
+                uint32_t timer = millis(), timeout = 500;
+                while (true)
+                {
+                    if (update() == toType(MessageType::MESH_ID_LOOKUP))
+                    {
+                        const FrameView reply = currentFrame();
+                        if ((reply.header().from_node == 00) && (reply.header().reserved == idLookupSequence))
+                        {
+                            return reply.get<int16_t>();
+                        }
+                    }
+                    if (millis() - timer > timeout)
+                    {
+                        return -1;
+                    }
+                }
+            }
+        }
+        return -1;
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::releaseAddress()
+    {
+        if (mesh_address == MESH_DEFAULT_ADDRESS)
+        {
+            return 0;
+        }
+
+        RF24Network::Header header(00, toType(MessageType::MESH_ADDR_RELEASE));
+        if (network.write(header, 0, 0))
+        {
+            trace(TraceEvent::RELEASE_SENT, mesh_address, nodeID);
+            network.begin(MESH_DEFAULT_ADDRESS);
+            mesh_address = MESH_DEFAULT_ADDRESS;
+            lastAddress = MESH_DEFAULT_ADDRESS;
+            return 1;
+        }
+        return 0;
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::sleep(const uint32_t duration)
+    {
+        if (isMaster() || (mesh_address == MESH_DEFAULT_ADDRESS))
+        {
+            return false;
+        }
+
+        RF24Network::Header header(parentOf(mesh_address), toType(MessageType::MESH_SLEEP));
+        const bool ok = network.write(header, &duration, sizeof(duration));
+        radio.powerDown();
+        return ok;
+    }
+
+    template<typename Role>
+    uint8_t BasicMesh<Role>::wake(const uint16_t timeout)
+    {
+        radio.powerUp();
+        radio.startListening();
+
+        if (isMaster() || (mesh_address == MESH_DEFAULT_ADDRESS))
+        {
+            return 0;
+        }
+
+        RF24Network::Header header(parentOf(mesh_address), toType(MessageType::MESH_MAIL_POLL));
+        if (!network.write(header, 0, 0))
+        {
+            return 0;
+        }
+
+        //The parent answers at once, with an empty delivery if it held nothing
+        uint8_t collected = 0;
+        const uint32_t timer = millis();
+        while (millis() - timer < timeout)
+        {
+            if (pollNetwork() != toType(MessageType::MESH_MAIL_DELIVER))
+            {
+                continue;
+            }
+
+            const FrameView frame = currentFrame();
+            collected += (frame.get<uint8_t>(3) != 0);
+            if (acceptMail(frame))
+            {
+                break;
+            }
+        }
+        return collected;
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::writeMail(const uint8_t nodeID, const void *const data, const uint8_t msg_type, const size_t size)
+    {
+        if (!msg_type || (size > MESH_MAIL_PAYLOAD_SIZE))
+        {
+            return false;
+        }
+
+        const int16_t address = getAddress(nodeID);
+        if (address <= 0)
+        {
+            return false;
+        }
+
+        const uint16_t parent = parentOf(address);
+        if (Role::routing && (parent == mesh_address))
+        {
+            return depositMail(address, mesh_address, msg_type, static_cast<const uint8_t *>(data), size);
+        }
+
+        uint8_t payload[MESH_FRAME_PAYLOAD_SIZE];
+        memcpy(&payload[0], &address, sizeof(uint16_t));
+        payload[2] = msg_type;
+        payload[3] = static_cast<uint8_t>(size);
+        if (size)
+        {
+            memcpy(&payload[4], data, size);
+        }
+
+        RF24Network::Header header(parent, toType(MessageType::MESH_MAIL_DEPOSIT));
+        return network.write(header, payload, 4 + size);
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::mailAvailable() const
+    {
+        return inboxCount != 0;
+    }
+
+    template<typename Role>
+    uint16_t BasicMesh<Role>::readMail(RF24Network::Header &header, void *const message, const uint16_t maxlen)
+    {
+        if (!inboxCount)
+        {
+            return 0;
+        }
+
+        const Mail &mail = inbox[inboxHead];
+        const uint16_t length = (mail.length < maxlen) ? mail.length : maxlen;
+
+        header.from_node = mail.from;
+        header.to_node = mesh_address;
+        header.type = mail.type;
+        memcpy(message, mail.data, length);
+
+        inboxHead = (inboxHead + 1) % (sizeof(inbox) / sizeof(inbox[0]));
+        inboxCount--;
+        return length;
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::acceptMail(const FrameView &frame)
+    {
+        const uint8_t capacity = sizeof(inbox) / sizeof(inbox[0]);
+        const uint8_t type = frame.get<uint8_t>(3);
+
+        if (Role::node && type)
+        {
+            //A full inbox drops the oldest message, the newest ones are the likeliest to matter
+            if (inboxCount == capacity)
+            {
+                inboxHead = (inboxHead + 1) % capacity;
+                inboxCount--;
+            }
+
+            Mail &mail = inbox[(inboxHead + inboxCount) % capacity];
+            mail.from = frame.get<uint16_t>(1);
+            mail.type = type;
+            mail.length = frame.get<uint8_t>(4);
+            if (mail.length > MESH_MAIL_PAYLOAD_SIZE)
+            {
+                mail.length = MESH_MAIL_PAYLOAD_SIZE;
+            }
+            memcpy(mail.data, frame.payload() + 5, mail.length);
+            inboxCount++;
+        }
+
+        return frame.get<uint8_t>(0) == 0;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::serviceMailbox(const uint8_t type)
+    {
+        if ((type != toType(MessageType::MESH_SLEEP)) && (type != toType(MessageType::MESH_MAIL_DEPOSIT)) &&
+            (type != toType(MessageType::MESH_MAIL_POLL)))
+        {
+            return;
+        }
+
+        const FrameView frame = currentFrame();
+        const uint16_t from = frame.header().from_node;
+        const uint32_t now = millis();
+
+        if (type == toType(MessageType::MESH_MAIL_DEPOSIT))
+        {
+            const uint16_t to = frame.get<uint16_t>(0);
+            uint8_t length = frame.get<uint8_t>(3);
+            if (length > MESH_MAIL_PAYLOAD_SIZE)
+            {
+                length = MESH_MAIL_PAYLOAD_SIZE;
+            }
+
+            if (parentOf(to) == mesh_address)
+            {
+                depositMail(to, from, frame.get<uint8_t>(2), frame.payload() + 4, length);
+            }
+            return;
+        }
+
+        //Only children talk to their parent about sleeping
+        if (parentOf(from) != mesh_address)
+        {
+            return;
+        }
+
+        Sleeper *sleeper = findSleeper(from);
+
+        if (type == toType(MessageType::MESH_SLEEP))
+        {
+            if (!sleeper)
+            {
+                //Take a free entry, or the one that has been overdue the longest
+                sleeper = &sleepers[0];
+                for (Sleeper &entry : sleepers)
+                {
+                    if (!entry.address || (static_cast<int32_t>(now - entry.until) >= 0))
+                    {
+                        sleeper = &entry;
+                        break;
+                    }
+                    if (static_cast<int32_t>(entry.until - sleeper->until) < 0)
+                    {
+                        sleeper = &entry;
+                    }
+                }
+            }
+
+            sleeper->address = from;
+            sleeper->until = now + frame.get<uint32_t>() + MESH_SLEEP_GRACE;
+            return;
+        }
+
+        //The child is awake, so hand over everything held for it in the order it arrived
+        uint8_t remaining = 0;
+        for (const Mail &mail : mailbox)
+        {
+            remaining += (mail.to == from);
+        }
+
+        if (sleeper)
+        {
+            sleeper->address = 0;
+        }
+
+        if (!remaining)
+        {
+            const uint8_t empty[5] = { 0, 0, 0, 0, 0 };
+            RF24Network::Header header(from, toType(MessageType::MESH_MAIL_DELIVER));
+            network.write(header, empty, sizeof(empty));
+            return;
+        }
+
+        while (remaining)
+        {
+            Mail *oldest = nullptr;
+            for (Mail &mail : mailbox)
+            {
+                if ((mail.to == from) && (!oldest || (static_cast<int32_t>(mail.stored - oldest->stored) < 0)))
+                {
+                    oldest = &mail;
+                }
+            }
+
+            deliverMail(*oldest, --remaining);
+            oldest->to = 0;
+        }
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::depositMail(const uint16_t to, const uint16_t from, const uint8_t type, const uint8_t *const data, const uint8_t length)
+    {
+        const uint32_t now = millis();
+        Mail *slot = nullptr;
+
+        if (findSleeper(to))
+        {
+            for (Mail &mail : mailbox)
+            {
+                if (!mail.to || (now - mail.stored > MESH_MAILBOX_TTL))
+                {
+                    slot = &mail;
+                    break;
+                }
+            }
+        }
+
+        Mail held;
+        Mail &mail = slot ? *slot : held;
+        mail.to = to;
+        mail.from = from;
+        mail.type = type;
+        mail.length = length;
+        mail.stored = now;
+        memcpy(mail.data, data, length);
+
+        if (slot)
+        {
+            return true;
+        }
+
+        //Awake, or no room to hold it, so try the child directly
+        return deliverMail(mail, 0);
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::deliverMail(const Mail &mail, const uint8_t remaining)
+    {
+        uint8_t payload[MESH_FRAME_PAYLOAD_SIZE];
+        payload[0] = remaining;
+        memcpy(&payload[1], &mail.from, sizeof(uint16_t));
+        payload[3] = mail.type;
+        payload[4] = mail.length;
+        memcpy(&payload[5], mail.data, mail.length);
+
+        RF24Network::Header header(mail.to, toType(MessageType::MESH_MAIL_DELIVER));
+        return network.write(header, payload, 5 + mail.length);
+    }
+
+    template<typename Role>
+    typename BasicMesh<Role>::Sleeper *BasicMesh<Role>::findSleeper(const uint16_t address)
+    {
+        const uint32_t now = millis();
+        for (Sleeper &entry : sleepers)
+        {
+            if (entry.address && (entry.address == address) && (static_cast<int32_t>(now - entry.until) < 0))
+            {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    template<typename Role>
+    uint8_t BasicMesh<Role>::reconnectCheck(const ReconnectState &state)
+    {
+        return 0xA5 ^ (state.address & 0xFF) ^ (state.address >> 8) ^ state.nodeID ^ state.channel;
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::getReconnectState(ReconnectState &state) const
+    {
+        const uint16_t address = (mesh_address != MESH_DEFAULT_ADDRESS) ? mesh_address : lastAddress;
+        if ((address == MESH_DEFAULT_ADDRESS) || !nodeID)
+        {
+            return false;
+        }
+
+        state.address = address;
+        state.nodeID = nodeID;
+        state.channel = (mesh_address != MESH_DEFAULT_ADDRESS) ? radio_channel : lastChannel;
+        state.check = reconnectCheck(state);
+        return true;
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::setReconnectState(const ReconnectState &state)
+    {
+        if ((state.check != reconnectCheck(state)) || (state.nodeID != getNodeID()) || (state.address == MESH_DEFAULT_ADDRESS))
+        {
+            return false;
+        }
+
+        lastAddress = state.address;
+        lastChannel = state.channel;
+        return true;
+    }
+
+    template<typename Role>
+    uint16_t BasicMesh<Role>::renewAddress(const uint32_t timeout)
+    {
+        if (!beginRenewal(timeout))
+        {
+            return 0;
+        }
+
+        while ((renewal.state != RenewalState::COMPLETE) && (renewal.state != RenewalState::FAILED))
+        {
+            update();
+        }
+
+        return (renewal.state == RenewalState::COMPLETE) ? mesh_address : 0;
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::beginRenewal(const uint32_t timeout)
+    {
+        if (radio.available())
+        {
+            return 0;
+        }
+        radio.stopListening();
+
+        network.networkFlags |= 2;
+
+        stats.count(&Stats::renewals);
+        renewal.start = millis();
+        renewal.timeout = timeout;
+        renewal.level = 0;
+        renewal.totalReqs = 0;
+        renewal.sent = false;
+        renewal.timer = millis();
+
+        if (mesh_address != MESH_DEFAULT_ADDRESS)
+        {
+            lastAddress = mesh_address;
+            lastChannel = radio_channel;
+        }
+
+        //Try getting the previous address back with one lookup before polling for a new one
+        if ((lastAddress != MESH_DEFAULT_ADDRESS) && (lastChannel == radio_channel))
+        {
+            mesh_address = lastAddress;
+            network.begin(mesh_address);
+            renewal.state = RenewalState::REATTACH;
+            return 1;
+        }
+
+        network.begin(MESH_DEFAULT_ADDRESS);
+        mesh_address = MESH_DEFAULT_ADDRESS;
+
+        //Give the radio a moment to settle before the first poll
+        renewal.state = RenewalState::BACKOFF;
+        renewal.wait = 10;
+        return 1;
+    }
+
+    template<typename Role>
+    RenewalState BasicMesh<Role>::renewalStatus() const
+    {
+        return renewal.state;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::setAllocationPolicy(const AllocationPolicy policy)
+    {
+        allocationPolicy = policy;
+    }
+
+    template<typename Role>
+    uint16_t BasicMesh<Role>::rehomeHint() const
+    {
+        return hintedParent;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::setRenewalCallback(const RenewalCallback callback)
+    {
+        renewal.callback = callback;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::stepRenewal(const uint8_t type)
+    {
+        const uint32_t now = millis();
+
+        switch (renewal.state)
+        {
+        case RenewalState::REATTACH:
+        {
+            if (!renewal.sent)
+            {
+                //Ask the master directly, a parent's cache could still hold the address after it was reassigned.
+                //A renewal only succeeds if the address is still ours, and it extends the lease as well.
+                RF24Network::Header header(00, toType(MessageType::MESH_ADDR_RENEW));
+                header.reserved = getNodeID();
+                uint8_t contacts[1 + (2 * (MESH_MAX_POLLS - 1))];
+                renewal.sent = network.write(header, contacts, writeContacts(contacts, parentOf(lastAddress)));
+                renewal.timer = now;
+
+                if (renewal.sent)
+                {
+                    break;
+                }
+            }
+            else if ((type == toType(MessageType::MESH_ADDR_RENEW)) && (currentFrame().header().from_node == 00) &&
+                     (currentFrame().header().reserved == getNodeID()))
+            {
+                const FrameView reply = currentFrame();
+                if (reply.get<int16_t>() == static_cast<int16_t>(lastAddress))
+                {
+                    stats.count(&Stats::reattaches);
+                    finishRenewal(true);
+                    break;
+                }
+            }
+            else if (now - renewal.timer < MESH_REATTACH_WINDOW)
+            {
+                break;
+            }
+
+            //The address is gone or the old parent is unreachable, so start over like a new node
+            lastAddress = MESH_DEFAULT_ADDRESS;
+            network.begin(MESH_DEFAULT_ADDRESS);
+            mesh_address = MESH_DEFAULT_ADDRESS;
+
+            renewal.state = RenewalState::BACKOFF;
+            renewal.timer = now;
+            renewal.wait = 10;
+            break;
+        }
+
+        case RenewalState::BACKOFF:
+        {
+            if (now - renewal.timer < renewal.wait)
+            {
+                break;
+            }
+
+            //Find another radio, starting with level 0 multicast
+#if defined(MESH_DEBUG_SERIAL)
+            Serial.print(millis());
+            Serial.println(F(" MSH: Poll "));
+#endif
+            //Replies echo this header, so parents that don't fill in their child count report a load of 0
+            RF24Network::Header header(0100, RF24Network::NETWORK_POLL);
+            header.reserved = 0;
+            network.multicast(header, 0, 0, renewal.level);
+            trace(TraceEvent::POLL_SENT, MESH_DEFAULT_ADDRESS, renewal.level);
+
+            renewal.pollCount = 0;
+            renewal.timer = millis();
+            renewal.state = RenewalState::POLL;
+            break;
+        }
+
+        case RenewalState::POLL:
+        {
+            if ((type == RF24Network::NETWORK_POLL) && (renewal.pollCount < MESH_MAX_POLLS))
+            {
+                const FrameView frame = currentFrame();
+                const bool goodSignal = radio.testRPD();
+                addContact(frame.header().from_node, goodSignal, frame.header().reserved);
+                trace(TraceEvent::POLL_HEARD, frame.header().from_node, frame.header().reserved);
+
+#if defined(MESH_DEBUG_SERIAL)
+                Serial.print(millis());
+                Serial.println(goodSignal ? F(" MSH: Poll > -64dbm ") : F(" MSH: Poll < -64dbm "));
+#elif defined(MESH_DEBUG_PRINTF)
+                printf("%u MSH: Poll %s -64dbm\n", millis(), goodSignal ? ">" : "<");
+#endif
+            }
+
+            if ((now - renewal.timer) <= MESH_POLL_WINDOW && (renewal.pollCount < MESH_MAX_POLLS))
+            {
+                break;
+            }
+
+            if (!renewal.pollCount)
+            {
+#if defined(MESH_DEBUG_SERIAL)
+                Serial.print(millis());
+                Serial.print(F(" MSH: No poll from level "));
+                Serial.println(renewal.level);
+#elif defined(MESH_DEBUG_PRINTF)
+                printf("%u MSH: No poll from level %d\n", millis(), renewal.level);
+#endif
+                retryRenewal();
+                break;
+            }
+
+#if defined(MESH_DEBUG_SERIAL)
+            Serial.print(millis());
+            Serial.print(F(" MSH: Got poll from level "));
+            Serial.print(renewal.level);
+            Serial.print(F(" count "));
+            Serial.println(renewal.pollCount);
+#elif defined(MESH_DEBUG_PRINTF)
+            printf("%u MSH: Got poll from level %d count %d\n", millis(), renewal.level, renewal.pollCount);
+#endif
+            renewal.contact = 0;
+            renewal.sent = false;
+            renewal.wait = 0;
+            renewal.timer = now;
+            renewal.state = RenewalState::REQUEST;
+            break;
+        }
+
+        case RenewalState::REQUEST:
+        {
+            if (!renewal.sent)
+            {
+                if (now - renewal.timer < renewal.wait)
+                {
+                    break;
+                }
+
+                // Request an address via the contact node
+                const uint16_t contactNode = renewal.contactNode[renewal.contact];
+                RF24Network::Header header(contactNode, RF24Network::NETWORK_REQ_ADDRESS);
+                header.reserved = getNodeID();
+
+                // Do a direct write (no ack) to the contact node. Include the nodeId, and the other contacts for the master to choose from.
+                uint8_t contacts[1 + (2 * (MESH_MAX_POLLS - 1))];
+                network.write(header, contacts, writeContacts(contacts, contactNode), contactNode);
+                trace(TraceEvent::REQUEST_SENT, contactNode, getNodeID());
+#if defined(MESH_DEBUG_SERIAL)
+                Serial.print(millis());
+                Serial.print(F(" MSH: Req addr from "));
+                Serial.println(contactNode, OCT);
+#elif defined(MESH_DEBUG_PRINTF)
+                printf("%u MSH: Request address from: 0%o\n", millis(), contactNode);
+#endif
+                renewal.sent = true;
+                renewal.timer = millis();
+                break;
+            }
+
+            if (type == RF24Network::NETWORK_ADDR_RESPONSE)
+            {
+                const FrameView frame = currentFrame();
+                const uint16_t newAddress = frame.get<uint16_t>();
+
+                if (!newAddress || frame.header().reserved != getNodeID())
+                {
+#if defined(MESH_DEBUG_SERIAL)
+                    Serial.print(millis());
+                    Serial.print(F(" MSH: Attempt Failed "));
+                    Serial.println(frame.header().reserved);
+                    Serial.print("My NodeID ");
+                    Serial.println(getNodeID());
+#elif defined(MESH_DEBUG_PRINTF)
+                    printf("%u Response discarded, wrong node 0%o sending node 0%o id %d\n", millis(), newAddress, MESH_DEFAULT_ADDRESS, frame.header().reserved);
+#endif
+                    retryRenewal();
+                    break;
+                }
+
+#if defined(MESH_DEBUG_SERIAL)
+                Serial.print(millis());
+                Serial.print(F(" Set address: "));
+                Serial.println(newAddress, OCT);
+#elif defined(MESH_DEBUG_PRINTF)
+                printf("Set address 0%o rcvd 0%o\n", mesh_address, newAddress);
+#endif
+                mesh_address = newAddress;
+                trace(TraceEvent::OFFER_RECEIVED, newAddress, getNodeID());
+
+                radio.stopListening();
+                network.begin(mesh_address);
+
+                renewal.attempts = 0;
+                renewal.timer = millis();
+                renewal.wait = 10;
+                renewal.state = RenewalState::CONFIRM;
+                break;
+            }
+
+            if (now - renewal.timer >= MESH_RESPONSE_WINDOW)
+            {
+                //No offer from this contact, so move on to the next one
+                if (++renewal.contact >= renewal.pollCount)
+                {
+                    retryRenewal();
+                    break;
+                }
+                renewal.sent = false;
+                renewal.wait = 5;
+                renewal.timer = now;
+            }
+            break;
+        }
+
+        case RenewalState::CONFIRM:
+        {
+            if (now - renewal.timer < renewal.wait)
+            {
+                break;
+            }
+
+            RF24Network::Header header(00, toType(MessageType::MESH_ADDR_CONFIRM));
+            if (network.write(header, 0, 0))
+            {
+                trace(TraceEvent::CONFIRM_SENT, mesh_address, getNodeID());
+                finishRenewal(true);
+            }
+            else if (renewal.attempts++ >= MESH_CONFIRM_RETRIES)
+            {
+                network.begin(MESH_DEFAULT_ADDRESS);
+                mesh_address = MESH_DEFAULT_ADDRESS;
+                retryRenewal();
+            }
+            else
+            {
+                renewal.timer = millis();
+                renewal.wait = 3;
+            }
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::addContact(const uint16_t contactNode, const bool goodSignal, const uint8_t load)
+    {
+        int16_t score = goodSignal ? MESH_RPD_WEIGHT : 0;
+        score -= load * MESH_LOAD_WEIGHT;
+        score -= addressLevel(contactNode) * MESH_DEPTH_WEIGHT;
+        score += (contactNode == hintedParent) ? MESH_HINT_WEIGHT : 0;
+        score = (score < INT8_MIN) ? INT8_MIN : score;
+
+        //Insert behind any contact that scores at least as well, so ties keep their arrival order
+        uint8_t i = renewal.pollCount;
+        while (i && (renewal.contactScore[i - 1] < score))
+        {
+            renewal.contactNode[i] = renewal.contactNode[i - 1];
+            renewal.contactScore[i] = renewal.contactScore[i - 1];
+            i--;
+        }
+
+        renewal.contactNode[i] = contactNode;
+        renewal.contactScore[i] = static_cast<int8_t>(score);
+        renewal.pollCount++;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::retryRenewal()
+    {
+        if (millis() - renewal.start > renewal.timeout)
+        {
+            finishRenewal(false);
+            return;
+        }
+
+        renewal.wait = 50 + ((renewal.totalReqs + 1) * (renewal.level + 1)) * 2;
+        renewal.timer = millis();
+        renewal.level = (renewal.level + 1) % 4;
+        renewal.totalReqs = (renewal.totalReqs + 1) % 10;
+        renewal.state = RenewalState::BACKOFF;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::finishRenewal(const bool success)
+    {
+        if (success)
+        {
+            network.networkFlags &= ~2;
+            stats.latency(&Stats::renewalLatency, millis() - renewal.start);
+
+            //Time spent without an address says nothing about the master, so a standby starts watching afresh
+            lastMasterContact = 0;
+            lastAddress = mesh_address;
+            lastChannel = radio_channel;
+            leaseRenewed = millis();
+            hintedParent = MESH_DEFAULT_ADDRESS;
+
+            //The new parent may relay lookups even if the old one didn't
+            parentLookupMisses = 0;
+
+            //Loss measured on the old attachment doesn't apply to the new one
+            probe.active = false;
+            probe.loss256 = 0;
+            probe.consecutiveLosses = 0;
+            probe.addressLost = false;
+        }
+        else
+        {
+            stats.count(&Stats::renewalFailures);
+        }
+
+        trace(success ? TraceEvent::RENEWAL_DONE : TraceEvent::RENEWAL_FAILED, mesh_address, getNodeID());
+        renewal.state = success ? RenewalState::COMPLETE : RenewalState::FAILED;
+        if (renewal.callback)
+        {
+            renewal.callback(success, mesh_address);
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::setNodeID(const uint8_t nodeID)
+    {
+        //A dedicated master is always 0
+        this->nodeID = Role::node ? nodeID : 0;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::setAddress(const uint8_t nodeID, const uint16_t address, const bool permanent)
+    {
+        if (!Role::master)
+        {
+            return;
+        }
+
+        const uint8_t previous = nodeSlot[nodeID];
+        const bool changed = (previous == MESH_INVALID_SLOT) || (addressList[previous].address != address) ||
+                             (addressList[previous].flags & MESH_LEASE_RELEASED);
+
+        if (!storeAddress(nodeID, address, permanent ? MESH_LEASE_PERMANENT : 0))
+        {
+            return;
+        }
+
+        if (changed)
+        {
+            notifyAddress(nodeID, address);
+        }
+
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+        journalAddress(nodeID);
+#endif
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::setAddressStorage(AddressList *const storage, const uint8_t capacity)
+    {
+        if (addressList && !dhcp->userAddressStorage && !MESH_STATIC_ADDRESS_POOL)
+        {
+            free(addressList);
+        }
+
+        beginTableWrite();
+        addressList = storage;
+        dhcp->addrListCapacity = storage ? capacity : 0;
+        dhcp->userAddressStorage = (storage != nullptr);
+        addrListTop = 0;
+        rebuildIndex();
+        endTableWrite();
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::loadDHCP()
+    {
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+        if (!Role::master)
+        {
+            return;
+        }
+
+        if (MESH_DHCP_USE_MMAP && mapDHCP())
+        {
+            return;
+        }
+
+        closeJournal();
+
+        int fd = ::open(MESH_DHCP_JOURNAL, O_RDWR);
+        if (fd < 0)
+        {
+            //No journal yet, so pick up a table saved by older releases and start one from it
+            std::ifstream infile(MESH_DHCP_FILE, std::ifstream::binary);
+            if (infile)
+            {
+                //Older releases wrote the entries without lease information
+                struct
+                {
+                    uint8_t nodeID;
+                    uint16_t address;
+                } entry;
+                while (infile.read((char *)&entry, sizeof(entry)))
+                {
+                    storeAddress(entry.nodeID, entry.address);
+                }
+                infile.close();
+            }
+            saveDHCP();
+            return;
+        }
+
+        //Replay every intact record. Anything after the first bad record is a torn write and is dropped.
+        JournalRecord record;
+        off_t good = 0;
+        dhcp->journalRecords = 0;
+        dhcp->journalSequence = 0;
+
+        while (::read(fd, &record, sizeof(record)) == static_cast<ssize_t>(sizeof(record)))
+        {
+            if ((record.version != MESH_JOURNAL_VERSION) || (record.crc != journalCRC(&record, offsetof(JournalRecord, crc))) ||
+                (dhcp->journalRecords && (record.sequence <= dhcp->journalSequence)))
+            {
+                break;
+            }
+
+            if (record.address == MESH_DEFAULT_ADDRESS)
+            {
+                if (nodeSlot[record.nodeID] != MESH_INVALID_SLOT)
+                {
+                    removeAddress(nodeSlot[record.nodeID]);
+                }
+            }
+            else if (storeAddress(record.nodeID, record.address, record.flags & MESH_LEASE_PERMANENT))
+            {
+                //Leases and holds pick up with what was left of them when the record was written
+                beginTableWrite();
+                AddressList &entry = addressList[nodeSlot[record.nodeID]];
+                entry.flags = record.flags;
+                entry.expires = millis() + record.remaining;
+                endTableWrite();
+            }
+            dhcp->journalSequence = record.sequence;
+            dhcp->journalRecords++;
+            good += sizeof(record);
+        }
+
+        if (!dhcp->journalRecords && replayLegacyJournal(fd))
+        {
+            ::close(fd);
+            saveDHCP();
+            return;
+        }
+
+        if (::ftruncate(fd, good) == 0 && ::lseek(fd, good, SEEK_SET) == good)
+        {
+            dhcp->journalFd = fd;
+            dhcp->lastFileSave = millis();
+        }
+        else
+        {
+            ::close(fd);
+        }
+
+        compactJournal();
+#endif
+    }
+
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+    template<typename Role>
+    bool BasicMesh<Role>::replayLegacyJournal(const int fd)
+    {
+        //Version 1 records, where address 0 is a release and there are no flags or expiry
+        struct
+        {
+            uint32_t sequence;
+            uint16_t address;
+            uint8_t nodeID;
+            uint8_t crc;
+        } legacy;
+        uint32_t sequence = 0;
+        bool replayed = false;
+
+        ::lseek(fd, 0, SEEK_SET);
+        while (::read(fd, &legacy, sizeof(legacy)) == static_cast<ssize_t>(sizeof(legacy)))
+        {
+            if ((legacy.crc != journalCRC(&legacy, offsetof(decltype(legacy), crc))) || (replayed && (legacy.sequence <= sequence)))
+            {
+                break;
+            }
+
+            if (legacy.address == MESH_DEFAULT_ADDRESS)
+            {
+                if (nodeSlot[legacy.nodeID] != MESH_INVALID_SLOT)
+                {
+                    removeAddress(nodeSlot[legacy.nodeID]);
+                }
+            }
+            else
+            {
+                storeAddress(legacy.nodeID, legacy.address);
+            }
+            sequence = legacy.sequence;
+            replayed = true;
+        }
+
+        dhcp->journalSequence = sequence;
+        return replayed;
+    }
+#endif
+
+    template<typename Role>
+    void BasicMesh<Role>::saveDHCP()
+    {
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+        if (dhcp->dhcpMap)
+        {
+            msync(dhcp->dhcpMap, dhcp->dhcpMapSize, MS_SYNC);
+            dhcp->lastFileSave = millis();
+            return;
+        }
+
+        //Write a fresh journal holding one record per entry, then swap it in atomically
+        char tmpName[sizeof(MESH_DHCP_JOURNAL) + 4];
+        snprintf(tmpName, sizeof(tmpName), "%s.tmp", MESH_DHCP_JOURNAL);
+
+        int fd = ::open(tmpName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            return;
+        }
+
+        bool ok = true;
+        for (uint8_t i = 0; ok && (i < addrListTop); i++)
+        {
+            JournalRecord record = journalEntry(addressList[i].nodeID);
+            record.sequence = ++dhcp->journalSequence;
+            record.crc = journalCRC(&record, offsetof(JournalRecord, crc));
+            ok = (::write(fd, &record, sizeof(record)) == static_cast<ssize_t>(sizeof(record)));
+        }
+
+        ok = ok && (::fsync(fd) == 0);
+        ::close(fd);
+
+        if (!ok || rename(tmpName, MESH_DHCP_JOURNAL) != 0)
+        {
+            ::unlink(tmpName);
+            return;
+        }
+
+        closeJournal();
+        dhcp->journalFd = ::open(MESH_DHCP_JOURNAL, O_WRONLY | O_APPEND);
+        dhcp->journalRecords = addrListTop;
+        dhcp->journalDirty = false;
+        dhcp->lastFileSave = millis();
+#endif
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::storeAddress(const uint8_t nodeID, const uint16_t address, const uint8_t flags)
+    {
+        if (!Role::master)
+        {
+            return false;
+        }
+
+        uint8_t position = nodeSlot[nodeID];
+
+        if ((position == MESH_INVALID_SLOT) && (addrListTop >= dhcp->addrListCapacity))
+        {
+#if defined(MESH_DEBUG_PRINTF)
+            printf("MSH: Address list full, dropped id %d\n", nodeID);
+#endif
+            return false;
+        }
+
+        beginTableWrite();
+        if (position == MESH_INVALID_SLOT)
+        {
+            position = addrListTop;
+            ++addrListTop;
+            nodeSlot[nodeID] = position;
+        }
+        else
+        {
+            indexAddress(position, false);
+        }
+
+        addressList[position].nodeID = nodeID;
+        addressList[position].address = address;
+        //A permanent 00 is the master's own nodeID, see promote()
+        if (address || (flags & MESH_LEASE_PERMANENT))
+        {
+            addressList[position].flags = flags;
+            addressList[position].expires = millis() + MESH_LEASE_TIME;
+        }
+        else
+        {
+            //Nothing to hold, so the entry goes on the next reclaim pass
+            addressList[position].flags = MESH_LEASE_RELEASED;
+            addressList[position].expires = millis();
+        }
+        indexAddress(position, true);
+        endTableWrite();
+        return true;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::removeAddress(const uint8_t slot)
+    {
+        const uint8_t last = addrListTop - 1;
+
+        beginTableWrite();
+        indexAddress(slot, false);
+        nodeSlot[addressList[slot].nodeID] = MESH_INVALID_SLOT;
+
+        if (slot != last)
+        {
+            indexAddress(last, false);
+            addressList[slot] = addressList[last];
+            nodeSlot[addressList[slot].nodeID] = slot;
+            indexAddress(slot, true);
+        }
+        addrListTop = last;
+        endTableWrite();
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::beginTableWrite()
+    {
+        if (!tableWriters++)
+        {
+            seqWriteBegin(*tableSequence);
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::endTableWrite()
+    {
+        if (--tableWriters)
+        {
+            return;
+        }
+
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+        if (dhcp->dhcpMap)
+        {
+            dhcp->dhcpMap->top = addrListTop;
+        }
+#endif
+        seqWriteEnd(*tableSequence);
+    }
+
+    template<typename Role>
+    uint8_t BasicMesh<Role>::copyTable(const uint32_t &sequence, const AddressList *const entries, const uint8_t &top, AddressList *const out,
+                                       const uint8_t max, uint32_t *const version)
+    {
+        //A bounded number of tries, as the writer may be another process that died part way through a change
+        uint32_t start = 1;
+        uint8_t count = 0;
+        for (uint16_t tries = 0; tries < MESH_SNAPSHOT_RETRIES; tries++)
+        {
+            start = seqReadBegin(sequence);
+            if (start & 1)
+            {
+                continue;
+            }
+
+            count = (top < max) ? top : max;
+            if (entries && count)
+            {
+                memcpy(out, entries, count * sizeof(AddressList));
+            }
+            if (!seqReadRetry(sequence, start))
+            {
+                break;
+            }
+            start |= 1;
+        }
+
+        if (version)
+        {
+            *version = start;
+        }
+        return (entries && !(start & 1)) ? count : 0;
+    }
+
+    template<typename Role>
+    uint8_t BasicMesh<Role>::snapshotTable(AddressList *const out, const uint8_t max, uint32_t *const version) const
+    {
+        return copyTable(*tableSequence, addressList, addrListTop, out, max, version);
+    }
+
+    template<typename Role>
+    uint32_t BasicMesh<Role>::tableVersion() const
+    {
+        return seqReadBegin(*tableSequence);
+    }
+
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+    template<typename Role>
+    uint8_t BasicMesh<Role>::journalCRC(const void *const data, const size_t length)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        uint8_t crc = 0;
+
+        for (size_t i = 0; i < length; i++)
+        {
+            crc ^= bytes[i];
+            for (uint8_t bit = 0; bit < 8; bit++)
+            {
+                crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+            }
+        }
+        return crc;
+    }
+
+    template<typename Role>
+    typename BasicMesh<Role>::JournalRecord BasicMesh<Role>::journalEntry(const uint8_t nodeID)
+    {
+        JournalRecord record;
+        memset(&record, 0, sizeof(record));
+        record.nodeID = nodeID;
+        record.version = MESH_JOURNAL_VERSION;
+        record.address = MESH_DEFAULT_ADDRESS;
+
+        const uint8_t slot = nodeSlot[nodeID];
+        if (slot != MESH_INVALID_SLOT)
+        {
+            const AddressList &entry = addressList[slot];
+            const int32_t left = static_cast<int32_t>(entry.expires - millis());
+            record.address = entry.address;
+            record.flags = entry.flags;
+            record.remaining = (!canExpire(entry) || (left < 0)) ? 0 : left;
+        }
+        return record;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::journalAddress(const uint8_t nodeID)
+    {
+        if (dhcp->dhcpMap)
+        {
+            //The entry itself already lives in the mapping, and endTableWrite() published the count
+            dhcp->journalDirty = true;
+            syncJournal();
+            return;
+        }
+
+        if (dhcp->journalFd < 0)
+        {
+            saveDHCP();
+            return;
+        }
+
+        JournalRecord record = journalEntry(nodeID);
+        record.sequence = ++dhcp->journalSequence;
+        record.crc = journalCRC(&record, offsetof(JournalRecord, crc));
+
+        if (::write(dhcp->journalFd, &record, sizeof(record)) != static_cast<ssize_t>(sizeof(record)))
+        {
+            //Leave the journal in a known state by rewriting it from the table
+            saveDHCP();
+            return;
+        }
+
+        dhcp->journalRecords++;
+        dhcp->journalDirty = true;
+
+        if (!compactJournal())
+        {
+            syncJournal();
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::syncJournal()
+    {
+        if (!dhcp->journalDirty || (millis() - dhcp->lastFileSave < MESH_MIN_SAVE_TIME))
+        {
+            return;
+        }
+
+        if (dhcp->dhcpMap)
+        {
+            msync(dhcp->dhcpMap, dhcp->dhcpMapSize, MS_ASYNC);
+        }
+        else if (dhcp->journalFd >= 0)
+        {
+            ::fdatasync(dhcp->journalFd);
+        }
+        dhcp->journalDirty = false;
+        dhcp->lastFileSave = millis();
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::compactJournal()
+    {
+        if (dhcp->dhcpMap || (dhcp->journalRecords < (2u * addrListTop) + MESH_JOURNAL_SLACK))
+        {
+            return false;
+        }
+
+        saveDHCP();
+        return true;
+    }
+
+    template<typename Role>
+    bool BasicMesh<Role>::mapDHCP(const char *const path)
+    {
+        if (!Role::master)
+        {
+            return false;
+        }
+
+        if (dhcp->dhcpMap)
+        {
+            return true;
+        }
+
+        const uint8_t capacity = MESH_ADDRESS_POOL_SIZE;
+        const size_t size = sizeof(DHCPMapHeader) + (capacity * sizeof(AddressList));
+
+        int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat info;
+        const bool fresh = (fstat(fd, &info) != 0) || (static_cast<size_t>(info.st_size) != size);
+        if (fresh && (::ftruncate(fd, size) != 0))
+        {
+            ::close(fd);
+            return false;
+        }
+
+        void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+        {
+            return false;
+        }
+
+        DHCPMapHeader *map = static_cast<DHCPMapHeader *>(mapping);
+        if (fresh || (map->magic != MESH_DHCP_MAP_MAGIC) || (map->version != MESH_DHCP_MAP_VERSION) || (map->capacity != capacity) || (map->top > capacity))
+        {
+            memset(mapping, 0, size);
+            map->magic = MESH_DHCP_MAP_MAGIC;
+            map->version = MESH_DHCP_MAP_VERSION;
+            map->capacity = capacity;
+            map->top = 0;
+        }
+
+        //A master that died part way through a change leaves the sequence odd
+        map->sequence += (map->sequence & 1);
+
+        closeJournal();
+        setAddressStorage(reinterpret_cast<AddressList *>(map + 1), capacity);
+
+        //From here on changes are published through the sequence in the mapping
+        tableSequence = &map->sequence;
+        beginTableWrite();
+        addrListTop = map->top;
+        rebuildIndex();
+
+        //Expiry times are in millis() of the last run, so every lease and hold starts over
+        const uint32_t now = millis();
+        for (uint8_t i = 0; i < addrListTop; i++)
+        {
+            AddressList &entry = addressList[i];
+            if (canExpire(entry))
+            {
+                entry.expires = now + ((entry.flags & MESH_LEASE_RELEASED) ? MESH_ADDRESS_HOLD_TIME : MESH_LEASE_TIME);
+            }
+        }
+
+        dhcp->dhcpMap = map;
+        dhcp->dhcpMapSize = size;
+        endTableWrite();
+        dhcp->lastFileSave = millis();
+        return true;
+    }
+
+    template<typename Role>
+    const DHCPMapHeader *BasicMesh<Role>::viewDHCP(const char *const path)
+    {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            return nullptr;
+        }
+
+        struct stat info;
+        void *mapping = MAP_FAILED;
+        if ((fstat(fd, &info) == 0) && (static_cast<size_t>(info.st_size) >= sizeof(DHCPMapHeader)))
+        {
+            mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+
+        if (mapping == MAP_FAILED)
+        {
+            return nullptr;
+        }
+
+        const DHCPMapHeader *map = static_cast<const DHCPMapHeader *>(mapping);
+        const size_t needed = sizeof(DHCPMapHeader) + (map->capacity * sizeof(AddressList));
+        if ((map->magic != MESH_DHCP_MAP_MAGIC) || (map->version != MESH_DHCP_MAP_VERSION) || (static_cast<size_t>(info.st_size) < needed))
+        {
+            munmap(mapping, info.st_size);
+            return nullptr;
+        }
+        return map;
+    }
+
+    template<typename Role>
+    uint8_t BasicMesh<Role>::snapshotDHCP(const DHCPMapHeader *const map, AddressList *const out, const uint8_t max, uint32_t *const version)
+    {
+        return copyTable(map->sequence, mappedEntries(map), map->top, out, max, version);
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::closeJournal()
+    {
+        if (dhcp->journalFd >= 0)
+        {
+            if (dhcp->journalDirty)
+            {
+                ::fdatasync(dhcp->journalFd);
+                dhcp->journalDirty = false;
+            }
+            ::close(dhcp->journalFd);
+            dhcp->journalFd = -1;
+        }
+    }
+#endif
+
+    template<typename Role>
+    void BasicMesh<Role>::DHCP()
+    {
+        if (!doDHCP)
+        {
+            return;
+        }
+
+        const uint32_t now = millis();
+        uint8_t pending = 0;
+
+        for (uint8_t i = 0; i < OfferSlots; i++)
+        {
+            Offer &offer = offers[i];
+
+            if (offer.state == OfferState::REQUESTED)
+            {
+                // ML: without this delay after the request, address renewal fails
+                if (now - offer.timer < MESH_OFFER_DELAY)
+                {
+                    pending++;
+                    continue;
+                }
+
+                offer.address = allocateAddress(offer);
+                if (!offer.address)
+                {
+#if defined(MESH_DEBUG_PRINTF)
+                    printf("not allocated\n");
+#endif
+                    offer.state = OfferState::FREE;
+                    continue;
+                }
+
+                RF24Network::Header header(offer.requester, RF24Network::NETWORK_ADDR_RESPONSE);
+                header.reserved = offer.nodeID;
+
+                if (offer.requester != MESH_DEFAULT_ADDRESS)
+                {
+                    //This is a routed request to 00, and is NOT node 01 to 05
+                    if (!network.write(header, &offer.address, sizeof(offer.address)))
+                    {
+                        network.write(header, &offer.address, sizeof(offer.address));
+                    }
+                }
+                else
+                {
+                    network.write(header, &offer.address, sizeof(offer.address), header.to_node);
+                }
+#if defined(MESH_DEBUG_PRINTF)
+                printf("Sent to 0%o phys: 0%o new: 0%o id: %d\n", header.to_node, MESH_DEFAULT_ADDRESS, offer.address, offer.nodeID);
+#endif
+                stats.count(&Stats::dhcpOffers);
+                trace(TraceEvent::OFFER_SENT, offer.address, offer.nodeID);
+                offer.state = OfferState::OFFERED;
+                offer.timer = millis();
+            }
+            else if (offer.state == OfferState::OFFERED)
+            {
+                //The requester never confirmed, so the address can be offered to someone else
+                if (now - offer.timer > network.routeTimeout)
+                {
+                    stats.count(&Stats::dhcpTimeouts);
+                    trace(TraceEvent::OFFER_EXPIRED, offer.address, offer.nodeID);
+                    offer.state = OfferState::FREE;
+                    continue;
+                }
+            }
+
+            pending += (offer.state != OfferState::FREE);
+        }
+
+        doDHCP = (pending != 0);
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::queueOffer(const uint8_t nodeID, const uint16_t requester, const FrameView &frame)
+    {
+        // Get the unique id of the requester
+        if (!nodeID)
+        {
+#if defined(MESH_DEBUG_PRINTF)
+            printf("MSH: Invalid id 0 rcvd\n");
+#endif
+            return;
+        }
+
+        //A repeated request from the same node replaces its outstanding offer
+        Offer *slot = nullptr;
+        for (uint8_t i = 0; i < OfferSlots; i++)
+        {
+            if ((offers[i].state != OfferState::FREE) && (offers[i].nodeID == nodeID))
+            {
+                slot = &offers[i];
+                break;
+            }
+
+            if (!slot && (offers[i].state == OfferState::FREE))
+            {
+                slot = &offers[i];
+            }
+        }
+
+        if (!slot)
+        {
+            //Every offer is in flight. The requester will poll again.
+            return;
+        }
+
+        slot->state = OfferState::REQUESTED;
+        slot->nodeID = nodeID;
+        slot->requester = requester;
+        slot->address = 0;
+        slot->timer = millis();
+        slot->alternateCount = readContacts(frame, slot->alternates);
+        doDHCP = true;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::confirmOffer(const uint16_t address)
+    {
+        for (uint8_t i = 0; i < OfferSlots; i++)
+        {
+            if ((offers[i].state == OfferState::OFFERED) && (offers[i].address == address))
+            {
+                offers[i].state = OfferState::FREE;
+                stats.count(&Stats::dhcpConfirms);
+                trace(TraceEvent::CONFIRM_RECEIVED, address, offers[i].nodeID);
+                setAddress(offers[i].nodeID, address);
+                return;
+            }
+        }
+    }
+
+    template<typename Role>
+    uint16_t BasicMesh<Role>::allocateAddress(const Offer &offer)
+    {
+        //A request straight from the default address was heard by the master itself
+        const uint16_t contact = (offer.requester != MESH_DEFAULT_ADDRESS) ? offer.requester : 00;
+        uint16_t parent = contact;
+        int16_t best = parentCost(contact, true, offer.nodeID);
+
+        for (uint8_t i = 0; i < offer.alternateCount; i++)
+        {
+            const int16_t cost = parentCost(offer.alternates[i], false, offer.nodeID);
+            if ((cost >= 0) && ((best < 0) || (cost < best)))
+            {
+                best = cost;
+                parent = offer.alternates[i];
+            }
+        }
+
+        if (best < 0)
+        {
+            return 0;
+        }
+        return allocateUnder(offer.nodeID, parent);
+    }
+
+    template<typename Role>
+    int16_t BasicMesh<Role>::defaultAllocationCost(const ParentCandidate &candidate)
+    {
+        int16_t cost = candidate.depth * MESH_ALLOC_DEPTH_WEIGHT;
+        cost += candidate.children * MESH_ALLOC_LOAD_WEIGHT;
+        cost -= candidate.contact ? MESH_ALLOC_CONTACT_BONUS : 0;
+        return (cost < 0) ? 0 : cost;
+    }
+
+    template<typename Role>
+    int16_t BasicMesh<Role>::parentCost(const uint16_t parent, const bool contact, const uint8_t from_id)
+    {
+        //Only the master and nodes it knows as active can take children, and only if the children still fit in an address
+        if (parent)
+        {
+            const uint8_t slot = findAddressSlot(parent);
+            if ((slot == MESH_INVALID_SLOT) || (addressList[slot].flags & MESH_LEASE_RELEASED) || (addressLevel(parent) >= MESH_MAX_LEVELS))
+            {
+                return -1;
+            }
+        }
+
+        ParentCandidate candidate;
+        candidate.address = parent;
+        candidate.depth = addressLevel(parent);
+        candidate.children = 0;
+        candidate.contact = contact;
+
+        const uint8_t capacity = MESH_MAX_CHILDREN + (parent ? 0 : 1);
+        for (uint8_t i = 1; i <= capacity; i++)
+        {
+            const uint8_t slot = findAddressSlot(parent | (i << (candidate.depth * 3)));
+            candidate.children += (slot != MESH_INVALID_SLOT) && (addressList[slot].nodeID != from_id);
+        }
+
+        if (candidate.children >= capacity)
+        {
+            return -1;
+        }
+        return allocationPolicy ? allocationPolicy(candidate) : defaultAllocationCost(candidate);
+    }
+
+    template<typename Role>
+    uint16_t BasicMesh<Role>::allocateUnder(const uint8_t from_id, const uint16_t parent)
+    {
+        uint16_t newAddress;
+        const uint16_t fwd_by = parent;
+        const uint8_t shiftVal = addressLevel(fwd_by) * 3; //Now we know how many bits to shift when adding a child node 1-5 (B001 to B101) to any address
+
+        //The master takes an extra child at level 1
+        const bool extraChild = !parent;
+
+#if defined(MESH_DEBUG_MINIMAL)
+        for (uint8_t i = 0; i < addrListTop; i++)
+        {
+#if !defined(__linux) && !defined ARDUINO_SAM_DUE || defined TEENSY || defined(__ARDUINO_X86__)
+            Serial.print("ID: ");
+            Serial.print(addressList[i].nodeID, DEC);
+            Serial.print(" ADDR: ");
+            uint16_t newAddr = addressList[i].address;
+            char addr[5] = "    ", count = 3, mask = 7;
+            while (newAddr)
+            {
+                addr[count] = (newAddr & mask) + 48; //get the individual Octal numbers, specified in chunks of 3 bits, convert to ASCII by adding 48
+                newAddr >>= 3;
+                count--;
+            }
+            Serial.println(addr);
+#else
+            printf("ID: %d ADDR: 0%o\n", addressList[i].nodeID, addressList[i].address);
+#endif
+        }
+#endif
+
+        for (int i = MESH_MAX_CHILDREN + extraChild; i > 0; i--)
+        {
+            // For each of the possible addresses (5 max)
+            newAddress = fwd_by | (i << shiftVal);
+            if (!newAddress || newAddress == MESH_DEFAULT_ADDRESS)
+            {
+                continue;
+            }
+
+            // The address is free if nobody holds it, or if the requester already owns it
+            const uint8_t slot = findAddressSlot(newAddress);
+            if ((slot != MESH_INVALID_SLOT) && (addressList[slot].nodeID != from_id))
+            {
+                continue;
+            }
+
+            // Nor may it be on offer to a different node right now
+            bool offered = false;
+            for (uint8_t j = 0; j < OfferSlots; j++)
+            {
+                if ((offers[j].state == OfferState::OFFERED) && (offers[j].address == newAddress) && (offers[j].nodeID != from_id))
+                {
+                    offered = true;
+                    break;
+                }
+            }
+
+            if (!offered)
+            {
+                return newAddress;
+            }
+        }
+
+        return 0;
+    }
+
+    template<typename Role>
+    uint16_t BasicMesh<Role>::addressToIndex(uint16_t address)
+    {
+        uint16_t index = 0;
+        uint16_t offset = 0;
+        uint16_t span = 1;
+
+        for (uint8_t level = 0; address; level++)
+        {
+            const uint8_t digit = address & 07;
+            if ((level >= MESH_MAX_LEVELS) || !digit || (digit > MESH_MAX_DIGIT))
+            {
+                return MESH_ADDRESS_INDEX_SIZE;
+            }
+
+            index += (digit - 1) * span;
+            address >>= 3;
+            span *= MESH_MAX_DIGIT;
+
+            //Skip over all the addresses that live on shallower levels
+            if (address)
+            {
+                offset += span;
+            }
+        }
+
+        return offset + index;
+    }
+
+    template<typename Role>
+    uint8_t BasicMesh<Role>::addressLevel(uint16_t address)
+    {
+        uint8_t count = 0;
+        while (address)
+        {
+            //Octal addresses convert nicely to binary in threes. Address 03 = B011  Address 033 = B011011
+            address >>= 3;
+            count++;
+        }
+        return count;
+    }
+
+    template<typename Role>
+    uint16_t BasicMesh<Role>::parentOf(const uint16_t address)
+    {
+        const uint8_t level = addressLevel(address);
+        return level ? (address & ((1 << ((level - 1) * 3)) - 1)) : 00;
+    }
+
+    template<typename Role>
+    uint8_t BasicMesh<Role>::findAddressSlot(const uint16_t address)
+    {
+        if (!Role::master || !address)
+        {
+            return MESH_INVALID_SLOT;
+        }
+
+        const uint16_t index = addressToIndex(address);
+        if (index < MESH_ADDRESS_INDEX_SIZE)
+        {
+            return addressSlot[index];
+        }
+
+        //Addresses outside of the tree can only be set manually, so fall back on a scan
+        for (uint8_t i = 0; i < addrListTop; i++)
+        {
+            if (addressList[i].address == address)
+            {
+                return i;
+            }
+        }
+        return MESH_INVALID_SLOT;
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::indexAddress(const uint8_t slot, const bool add)
+    {
+        const uint16_t index = addressToIndex(addressList[slot].address);
+        if (!Role::master || !addressList[slot].address || (index >= MESH_ADDRESS_INDEX_SIZE))
+        {
+            return;
+        }
+
+        if (add)
+        {
+            addressSlot[index] = slot;
+        }
+        else if (addressSlot[index] == slot)
+        {
+            addressSlot[index] = MESH_INVALID_SLOT;
+        }
+    }
+
+    template<typename Role>
+    void BasicMesh<Role>::rebuildIndex()
+    {
+        memset(nodeSlot, MESH_INVALID_SLOT, sizeof(nodeSlot));
+        memset(addressSlot, MESH_INVALID_SLOT, sizeof(addressSlot));
+
+        for (uint8_t i = 0; i < addrListTop; i++)
+        {
+            nodeSlot[addressList[i].nodeID] = i;
+            indexAddress(i, true);
+        }
+    }
+
+    template class BasicMesh<DynamicRole>;
+    template class BasicMesh<RouterRole>;
+    template class BasicMesh<LeafRole>;
+#if !defined(RF24_TINY) && !defined(MESH_NOMASTER)
+    template class BasicMesh<MasterRole>;
+#endif
+}
@@ -13,6 +13,7 @@
 #include <cstdlib>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 /* NRF Library Headers */
 #include "nrf24l01.hpp"
@@ -23,17 +24,585 @@
 
 namespace RF24Mesh
 {
+    /**
+    *   Progress of an address renewal started with Mesh::beginRenewal()
+    */
+    enum class RenewalState : uint8_t
+    {
+        IDLE,     /**< No renewal has been started */
+        REATTACH, /**< Checking with the master that the previous address is still ours */
+        BACKOFF,  /**< Waiting before the next poll sweep */
+        POLL,     /**< Collecting poll responses from nearby nodes */
+        REQUEST,  /**< Waiting on an address offer from a contact node */
+        CONFIRM,  /**< Confirming the offered address with the master */
+        COMPLETE, /**< An address was assigned */
+        FAILED    /**< The renewal timed out */
+    };
+
+    /**
+    *   Notification that an asynchronous renewal finished
+    *
+    *   @param[in]  success     True if an address was assigned
+    *   @param[in]  address     The newly assigned address, or MESH_DEFAULT_ADDRESS on failure
+    */
+    using RenewalCallback = void (*)(const bool success, const uint16_t address);
+
+    /**
+    *   What a node needs to get its address back quickly after a reset, see Mesh::getReconnectState()
+    */
+    struct ReconnectState
+    {
+        uint16_t address;
+        uint8_t nodeID;
+        uint8_t channel;
+        uint8_t check;  /**< Guards against restoring uninitialised memory */
+    };
+
+    /**
+    *   Connection quality measured by Mesh::probeConnection()
+    */
+    struct LinkQuality
+    {
+        uint16_t srtt;              /**< Smoothed round trip time to the master in ms */
+        uint16_t rttvar;            /**< Round trip time variation in ms */
+        uint16_t timeout;           /**< How long the next probe will wait, srtt + 4 * rttvar */
+        uint8_t loss;               /**< Smoothed share of lost probes in percent */
+        uint8_t consecutiveLosses;  /**< Probes lost since the last reply */
+        uint16_t samples;           /**< Replies measured */
+        bool addressLost;           /**< The master no longer has this node at its current address */
+    };
+
+    /**
+    *   Notification that a standby master has taken over as the master, called from Mesh::update()
+    */
+    using PromotionCallback = void (*)();
+
+    /**
+    *   Outcome of a write queued with Mesh::queueWrite()
+    */
+    enum class SendStatus : uint8_t
+    {
+        UNKNOWN,      /**< The handle does not refer to a queued write, or its slot has been reused */
+        PENDING,      /**< Waiting on an address lookup or a retry */
+        SENT,         /**< The network layer accepted the frame */
+        TIMEOUT,      /**< The deadline passed before the write succeeded */
+        UNKNOWN_NODE, /**< The master has no address for the destination nodeID */
+        REFUSED       /**< The receiver of a bulk transfer had no room for it, see Mesh::setBulkBuffer() */
+    };
+
+    /**
+    *   Identifies a queued write, MESH_INVALID_HANDLE if nothing was queued
+    */
+    using SendHandle = uint16_t;
+
+    /**
+    *   Notification that a queued write finished, called from Mesh::update()
+    *
+    *   @param[in]  handle      The handle returned by Mesh::queueWrite()
+    *   @param[in]  status      How the write finished
+    */
+    using SendCallback = void (*)(const SendHandle handle, const SendStatus status);
+
+    /**
+    *   A parent the master could place a joining node under, see Mesh::setAllocationPolicy()
+    */
+    struct ParentCandidate
+    {
+        uint16_t address;   /**< The parent's address, 00 for the master */
+        uint8_t depth;      /**< Octal level of the parent */
+        uint8_t children;   /**< Child addresses of the parent that are already taken */
+        bool contact;       /**< The parent relayed the request, so the link to it is known to work */
+    };
+
+    /**
+    *   Rates a candidate parent. The master places the node under the candidate with the lowest cost,
+    *   and a negative cost rules a candidate out.
+    */
+    using AllocationPolicy = int16_t (*)(const ParentCandidate &candidate);
+
+    /**
+    *   One entry of the master's address table
+    */
+    struct AddressList
+    {
+        uint8_t nodeID;
+        uint8_t flags;    /**< MESH_LEASE_RELEASED, MESH_LEASE_PERMANENT */
+        uint16_t address;
+        uint32_t expires; /**< millis() at which the lease, or the hold on a released address, runs out */
+    };
+
+    /**
+    *   Layout of the memory mapped address table on Linux masters. The header is followed
+    *   directly by `capacity` AddressList entries, of which the first `top` are in use.
+    */
+    struct DHCPMapHeader
+    {
+        uint32_t magic;    /**< MESH_DHCP_MAP_MAGIC */
+        uint16_t version;  /**< MESH_DHCP_MAP_VERSION */
+        uint8_t capacity;  /**< Number of entries following the header */
+        uint8_t top;       /**< Number of entries in use, mirrors Mesh::addrListTop */
+        uint32_t sequence; /**< Odd while the master is changing the table, see Mesh::snapshotDHCP() */
+    };
+
+    /**
+    *   Counts of events in fixed latency ranges, see MESH_LATENCY_BOUNDS
+    */
+    struct LatencyHistogram
+    {
+        uint32_t buckets[MESH_LATENCY_BUCKETS];
+    };
+
+    /**
+    *   Runtime counters of the mesh layer, available through Mesh::getStats()
+    */
+    struct MeshStats
+    {
+        uint32_t lookupsServed;      /**< Master: nodeIDs and addresses resolved for other nodes */
+        uint32_t lookupsSent;        /**< Lookup requests sent to the master */
+        uint32_t lookupFailures;     /**< Lookup requests that went unanswered or were not found */
+        uint32_t lookupCacheHits;    /**< Writes that used a cached address instead of a lookup */
+        uint32_t dhcpRequests;       /**< Master: address requests received */
+        uint32_t dhcpOffers;         /**< Master: addresses offered */
+        uint32_t dhcpConfirms;       /**< Master: offers confirmed and assigned */
+        uint32_t dhcpTimeouts;       /**< Master: offers that were never confirmed */
+        uint32_t renewals;           /**< Address renewals started */
+        uint32_t renewalFailures;    /**< Address renewals that timed out */
+        uint32_t reattaches;         /**< Renewals completed by getting the previous address back */
+        uint32_t connectionChecks;   /**< Calls to checkConnection() */
+        uint32_t connectionFailures; /**< checkConnection() calls that found the mesh unreachable */
+        uint32_t writes;             /**< Calls to write() */
+        uint32_t writeFailures;      /**< write() calls that failed */
+        uint32_t bulkFragments;      /**< Bulk fragments sent, including resends */
+        uint32_t bulkResends;        /**< Bulk fragments sent again after being reported missing */
+        LatencyHistogram lookupLatency;  /**< Time taken by successful lookups */
+        LatencyHistogram renewalLatency; /**< Time taken by successful renewals */
+    };
+
+    /**
+    *   Seqlock over data the radio loop owns. The sequence is odd while the data is being changed, and a reader
+    *   copies the data between two reads of the sequence, trying again if it moved. Writers never wait on readers,
+    *   so monitors on another thread, or another process through a shared mapping, can't hold up update().
+    */
+    inline void seqWriteBegin(uint32_t &sequence)
+    {
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+        __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+#else
+        sequence++;
+#endif
+    }
+
+    inline void seqWriteEnd(uint32_t &sequence)
+    {
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+        __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELEASE);
+#else
+        sequence++;
+#endif
+    }
+
+    /**
+    *   @return The sequence to pass to seqReadRetry() once the copy is taken. Odd while a write is in progress,
+    *   in which case the copy is not worth taking. Readers give up after MESH_SNAPSHOT_RETRIES tries rather than
+    *   wait on a writer that may never finish.
+    */
+    inline uint32_t seqReadBegin(const uint32_t &sequence)
+    {
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+        return __atomic_load_n(&sequence, __ATOMIC_ACQUIRE);
+#else
+        return sequence;
+#endif
+    }
+
+    /**
+    *   @return True if the data changed while it was being copied, so the copy must be taken again
+    */
+    inline bool seqReadRetry(const uint32_t &sequence, const uint32_t start)
+    {
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        return __atomic_load_n(&sequence, __ATOMIC_RELAXED) != start;
+#else
+        return sequence != start;
+#endif
+    }
+
+    /**
+    *   Keeps the mesh counters when MESH_ENABLE_STATS is set, and compiles to nothing otherwise.
+    *   Updates go through a seqlock so snapshot() is consistent when called from another thread.
+    */
+    template<bool enabled>
+    class StatsRecorder
+    {
+    public:
+        void count(uint32_t MeshStats::*counter, const uint32_t amount = 1)
+        {
+            seqWriteBegin(sequence);
+            data.*counter += amount;
+            seqWriteEnd(sequence);
+        }
+
+        void latency(LatencyHistogram MeshStats::*histogram, const uint32_t elapsed)
+        {
+            uint8_t bucket = 0;
+            while ((bucket < MESH_LATENCY_BUCKETS - 1) && (elapsed > MESH_LATENCY_BOUNDS[bucket]))
+            {
+                bucket++;
+            }
+            seqWriteBegin(sequence);
+            (data.*histogram).buckets[bucket]++;
+            seqWriteEnd(sequence);
+        }
+
+        uint32_t snapshot(MeshStats &out) const
+        {
+            uint32_t start = 1;
+            for (uint16_t tries = 0; tries < MESH_SNAPSHOT_RETRIES; tries++)
+            {
+                start = seqReadBegin(sequence);
+                if (start & 1)
+                {
+                    continue;
+                }
+
+                MeshStats copy = data;
+                if (!seqReadRetry(sequence, start))
+                {
+                    out = copy;
+                    return start;
+                }
+            }
+            return start | 1;
+        }
+
+        void reset()
+        {
+            seqWriteBegin(sequence);
+            data = MeshStats();
+            seqWriteEnd(sequence);
+        }
+
+    private:
+        MeshStats data = MeshStats();
+        uint32_t sequence = 0;
+    };
+
+    template<>
+    class StatsRecorder<false>
+    {
+    public:
+        void count(uint32_t MeshStats::*, const uint32_t = 1) {}
+        void latency(LatencyHistogram MeshStats::*, const uint32_t) {}
+        uint32_t snapshot(MeshStats &out) const { out = MeshStats(); return 0; }
+        void reset() {}
+    };
+
+    /**
+    *   Mesh events recorded in the trace ring, see Mesh::readTrace()
+    */
+    enum class TraceEvent : uint8_t
+    {
+        POLL_SENT,          /**< nodeID holds the multicast level polled */
+        POLL_HEARD,         /**< address answered the poll, nodeID holds its load hint */
+        REQUEST_SENT,       /**< address is the contact node asked for an address */
+        REQUEST_RECEIVED,   /**< Master: nodeID asked for an address through the contact node at address */
+        OFFER_SENT,         /**< Master: address was offered to nodeID */
+        OFFER_RECEIVED,     /**< address was offered to this node */
+        OFFER_EXPIRED,      /**< Master: the offer of address to nodeID was never confirmed */
+        CONFIRM_SENT,       /**< This node took address */
+        CONFIRM_RECEIVED,   /**< Master: nodeID now holds address */
+        LOOKUP_SENT,        /**< The address of nodeID was asked for */
+        LOOKUP_ANSWERED,    /**< nodeID is at address */
+        LOOKUP_FAILED,      /**< The lookup of nodeID went unanswered or was not found */
+        LOOKUP_SERVED,      /**< Master: a lookup involving nodeID was answered for the node at address */
+        RELEASE_SENT,       /**< This node gave up address */
+        RELEASE_RECEIVED,   /**< Master: nodeID gave up address */
+        RENEWAL_DONE,       /**< The renewal ended with this node at address */
+        RENEWAL_FAILED
+    };
+
+    /**
+    *   @return A short name for the event, for host tools printing a trace
+    */
+    const char *traceEventName(const TraceEvent event);
+
+    struct TraceRecord
+    {
+        uint32_t time;      /**< millis() when the event was recorded */
+        uint16_t address;
+        TraceEvent event;
+        uint8_t nodeID;
+    };
+
+    /**
+    *   Keeps the trace ring when MESH_ENABLE_TRACE is set, and compiles to nothing otherwise.
+    *   A record is a masked index and an 8 byte store, so it can sit on the hot paths.
+    */
+    template<bool enabled>
+    class TraceRecorder
+    {
+        static_assert(MESH_TRACE_DEPTH && !(MESH_TRACE_DEPTH & (MESH_TRACE_DEPTH - 1)), "MESH_TRACE_DEPTH must be a power of two");
+
+    public:
+        void record(const uint32_t time, const TraceEvent event, const uint16_t address, const uint8_t nodeID)
+        {
+            TraceRecord &entry = ring[written++ & (MESH_TRACE_DEPTH - 1)];
+            entry.time = time;
+            entry.address = address;
+            entry.event = event;
+            entry.nodeID = nodeID;
+        }
+
+        uint16_t read(TraceRecord *const out, const uint16_t max, uint32_t &cursor) const
+        {
+            //Anything older than the ring has already been overwritten
+            if (written - cursor > MESH_TRACE_DEPTH)
+            {
+                cursor = written - MESH_TRACE_DEPTH;
+            }
+
+            uint16_t count = 0;
+            while ((cursor != written) && (count < max))
+            {
+                out[count++] = ring[cursor++ & (MESH_TRACE_DEPTH - 1)];
+            }
+            return count;
+        }
+
+        uint32_t total() const
+        {
+            return written;
+        }
+
+    private:
+        uint32_t written = 0;
+        TraceRecord ring[MESH_TRACE_DEPTH];
+    };
+
+    template<>
+    class TraceRecorder<false>
+    {
+    public:
+        void record(const uint32_t, const TraceEvent, const uint16_t, const uint8_t) {}
+        uint16_t read(TraceRecord *const, const uint16_t, uint32_t &) const { return 0; }
+        uint32_t total() const { return 0; }
+    };
+
+    /**
+    *   State that only some roles use. Roles that use it hold a T, the others hold nothing and share one
+    *   placeholder, which their code only reaches on paths the role rules out.
+    */
+    template<typename T, bool enabled>
+    class RoleStorage
+    {
+    public:
+        T *operator->() { return &value; }
+        const T *operator->() const { return &value; }
+        T &operator*() { return value; }
+
+    private:
+        T value;
+    };
+
+    template<typename T>
+    class RoleStorage<T, false>
+    {
+    public:
+        T *operator->() { return &placeholder; }
+        const T *operator->() const { return &placeholder; }
+        T &operator*() { return placeholder; }
+
+    private:
+        static T placeholder;
+    };
+
+    template<typename T>
+    T RoleStorage<T, false>::placeholder;
+
+    /**
+    *   A read-only view of a frame held in the network frame buffer. Nothing is copied out of the
+    *   buffer, so the view is only valid until the next frame is received. Mesh::isCurrent() tells
+    *   whether that has happened.
+    */
+    class FrameView
+    {
+    public:
+        FrameView(const uint8_t *const buffer, const uint32_t sequence, const size_t length = MESH_FRAME_PAYLOAD_SIZE) :
+            buffer(buffer), frameSequence(sequence), length(length)
+        {
+        }
+
+        /**
+        *   The header of the frame, parsed in place
+        */
+        const RF24Network::Header &header() const
+        {
+            return *reinterpret_cast<const RF24Network::Header *>(buffer);
+        }
+
+        uint8_t type() const
+        {
+            return header().type;
+        }
+
+        /**
+        *   The payload of the frame
+        */
+        const uint8_t *payload() const
+        {
+            return buffer + sizeof(RF24Network::Header);
+        }
+
+        /**
+        *   Length of the payload. Frames still in the network frame buffer report the largest payload a
+        *   frame can carry, since the network layer does not keep the received length.
+        */
+        size_t size() const
+        {
+            return length;
+        }
+
+        /**
+        *   Reads a value out of the payload. Safe for any alignment of the frame buffer.
+        *
+        *   @param[in]  offset      Byte offset into the payload
+        *   @return The value, or a zero value if it would run past the end of the payload
+        */
+        template<typename T>
+        T get(const size_t offset = 0) const
+        {
+            T value = T();
+            if (offset + sizeof(T) <= size())
+            {
+                memcpy(&value, payload() + offset, sizeof(T));
+            }
+            return value;
+        }
+
+        /**
+        *   Identifies the frame, see Mesh::isCurrent()
+        */
+        uint32_t sequence() const
+        {
+            return frameSequence;
+        }
+
+    private:
+        const uint8_t *buffer;
+        uint32_t frameSequence;
+        size_t length;
+    };
 
-    class Mesh
+    /**
+    *   Receives an application frame routed by Mesh::update(). The view is only valid for the
+    *   duration of the call.
+    */
+    using FrameHandler = void (*)(const FrameView &frame);
+
+    /**
+    *   Binds a user message type (1-127) to its handler, see makeDispatchTable()
+    */
+    struct HandlerEntry
+    {
+        uint8_t type;
+        FrameHandler handler;
+    };
+
+    /**
+    *   Handlers indexed directly by message type, so routing a frame costs a single array lookup
+    */
+    struct DispatchTable
+    {
+        FrameHandler handlers[MESH_USER_TYPES];
+    };
+
+    /**
+    *   Builds a dispatch table at compile time. Entries outside the user range are ignored.
+    *
+    *   @code
+    *   constexpr RF24Mesh::DispatchTable handlers = RF24Mesh::makeDispatchTable(
+    *       RF24Mesh::HandlerEntry{ 'M', onMeasurement },
+    *       RF24Mesh::HandlerEntry{ 'S', onStatus });
+    *   mesh.setDispatchTable(&handlers);
+    *   @endcode
+    *
+    *   @param[in]  entries     Type/handler pairs, later entries replace earlier ones for the same type
+    *   @return The table
+    */
+    template<typename... Entries>
+    constexpr DispatchTable makeDispatchTable(const Entries... entries)
+    {
+        DispatchTable table = {};
+        const HandlerEntry list[] = { HandlerEntry{ 0, nullptr }, entries... };
+
+        for (size_t i = 1; i < sizeof(list) / sizeof(list[0]); i++)
+        {
+            if (list[i].type && (list[i].type < MESH_USER_TYPES))
+            {
+                table.handlers[list[i].type] = list[i].handler;
+            }
+        }
+        return table;
+    }
+
+    /*------------------------------------------------
+    Role policies for BasicMesh. A fixed role lets the compiler drop the code paths and
+    size down the tables a node can never use.
+    ------------------------------------------------*/
+    struct MasterRole
+    {
+        static constexpr bool master = true;   /**< Runs DHCP and owns the address table */
+        static constexpr bool node = false;    /**< Requests an address from a master */
+        static constexpr bool routing = true;  /**< Lets children attach */
+    };
+
+    struct RouterRole
+    {
+        static constexpr bool master = false;
+        static constexpr bool node = true;
+        static constexpr bool routing = true;
+    };
+
+    struct LeafRole
+    {
+        static constexpr bool master = false;
+        static constexpr bool node = true;
+        static constexpr bool routing = false;
+    };
+
+    /**
+    *   Decides by nodeID at runtime, as the mesh always has. Needed for standby masters.
+    */
+    struct DynamicRole
     {
+        static constexpr bool master = true;
+        static constexpr bool node = true;
+        static constexpr bool routing = true;
+    };
+
+    /**
+    *   The mesh, specialised for one role. Use the aliases below: Mesh decides the role at runtime,
+    *   MasterMesh, RouterMesh and LeafMesh fix it at compile time. Only roles that can be the master keep
+    *   the address list bookkeeping, and a LeafMesh sizes its send queue and lookup cache with the
+    *   MESH_LEAF_ settings and leaves out bulk transfers unless MESH_LEAF_BULK is set.
+    */
+    template<typename Role>
+    class BasicMesh
+    {
+        static_assert(Role::master || Role::node, "A mesh role must be a master, a node, or both");
+
     public:
+        using Stats = MeshStats;
+
         /**
         *   Construct the mesh object
         *
         *   @param[in]  radio      The underlying radio driver instance
         *   @param[in]  network    The underlying network instance
         */
-        Mesh(NRF24L::NRF24L01 &radio, RF24Network::Network &network);
+        BasicMesh(NRF24L::NRF24L01 &radio, RF24Network::Network &network);
 
         /**
          * Configures the mesh and requests an address
@@ -57,7 +626,8 @@ namespace RF24Mesh
         /**
          *  Write a message onto the network
          *
-         *  @note Including the nodeID parameter will result in an automatic address lookup being performed.
+         *  @note Including the nodeID parameter will result in an automatic address lookup being performed, unless the address
+         *  is already cached. The lookup may take up to MESH_LOOKUP_TIMEOUT, during which update() runs as usual, and the write itself is a single attempt.
          *  @note Message types 1-64 (decimal) will NOT be acknowledged by the network, types 65-127 will be. Use as appropriate to manage traffic:
          *  if expecting a response, no ack is needed.
          *
@@ -72,11 +642,104 @@ namespace RF24Mesh
                    const size_t size,
                    const uint8_t nodeID = 0);
 
+        /**
+         *  Queue a message to be sent from update(). Address lookups and retries happen in the background,
+         *  so a destination that cannot be reached does not hold up writes to other nodes.
+         *  Failed writes are retried with exponential backoff plus jitter until the timeout passes.
+         *
+         *  @note Writes are sent by priority: mesh control types first, then the acked user types 65-127,
+         *  then the unacked 1-64. While an address request, offer or lookup is outstanding, unacked writes
+         *  and bulk fragments wait and only MESH_ACKED_BUDGET acked writes go out per update().
+         *
+         *  @param[in]  data        The data to send, copied into the queue
+         *  @param[in]  msg_type    The msg_type for the message
+         *  @param[in]  size        The size of the data, at most MESH_FRAME_PAYLOAD_SIZE
+         *  @param[in]  nodeID      The nodeID of the recipient, the master by default
+         *  @param[in]  timeout     How long the write may keep retrying in milliseconds
+         *  @param[in]  callback    **Optional**: Called from update() once the write finishes
+         *  @return A handle for sendStatus(), or MESH_INVALID_HANDLE if the queue is full or the payload too large.
+         *  The queue holds MESH_SEND_QUEUE_SIZE writes, MESH_LEAF_SEND_QUEUE_SIZE on a LeafMesh.
+         */
+        SendHandle queueWrite(const void *const data,
+                              const uint8_t msg_type,
+                              const size_t size,
+                              const uint8_t nodeID = 0,
+                              const uint32_t timeout = MESH_WRITE_TIMEOUT,
+                              const SendCallback callback = nullptr);
+
+        /**
+         *  Check on a queued write. The outcome stays available until its queue slot is reused.
+         *
+         *  @param[in]  handle      A handle returned by queueWrite()
+         *  @return The state of the write
+         */
+        SendStatus sendStatus(const SendHandle handle) const;
+
+        /**
+         *  Start sending a block of data too large for a single frame. It goes out from update() as a window of
+         *  pipelined fragments, and only the fragments the receiver reports missing are sent again.
+         *  The destination is resolved the same way as for queueWrite(). One transfer can be outgoing at a time.
+         *
+         *  @param[in]  nodeID      The nodeID of the recipient, which must have called setBulkBuffer()
+         *  @param[in]  data        The data to send. It is not copied, so must stay valid until the transfer finishes.
+         *  @param[in]  size        Length of the data, at most MESH_BULK_MAX_SIZE
+         *  @param[in]  timeout     How long the whole transfer may take in milliseconds
+         *  @param[in]  callback    **Optional**: Called from update() once the transfer finishes, with MESH_INVALID_HANDLE as the handle
+         *  @return False if a transfer is already outgoing or the size is out of range, and always on a LeafMesh
+         *  built without MESH_LEAF_BULK
+         */
+        bool beginBulk(const uint8_t nodeID,
+                       const void *const data,
+                       const size_t size,
+                       const uint32_t timeout = MESH_BULK_TIMEOUT,
+                       const SendCallback callback = nullptr);
+
+        /**
+         *  As beginBulk(), but waits for the transfer to finish
+         *
+         *  @return True once the receiver has acknowledged every fragment
+         */
+        bool sendBulk(const uint8_t nodeID, const void *const data, const size_t size, const uint32_t timeout = MESH_BULK_TIMEOUT);
+
+        /**
+         *  @return The state of the last transfer started with beginBulk()
+         */
+        SendStatus bulkStatus() const;
+
+        /**
+         *  @return Bytes of the outgoing transfer the receiver has acknowledged in order so far
+         */
+        uint32_t bulkProgress() const;
+
+        /**
+         *  Give the mesh somewhere to reassemble incoming bulk transfers. Transfers are refused until this
+         *  is called, while another sender's transfer is part way through, and while a completed transfer
+         *  has not been taken with readBulk(). A LeafMesh built without MESH_LEAF_BULK refuses every transfer.
+         *
+         *  @param[in]  buffer      Receives the data, or nullptr to stop accepting transfers
+         *  @param[in]  capacity    Size of buffer, larger transfers are refused
+         */
+        void setBulkBuffer(void *const buffer, const size_t capacity);
+
+        /**
+         *  @return True if a transfer has been reassembled in the bulk buffer
+         */
+        bool bulkAvailable() const;
+
+        /**
+         *  Hand the bulk buffer back for the next transfer
+         *
+         *  @param[out] from        Receives the address of the sender
+         *  @return The length of the transfer waiting in the buffer, 0 if none was complete
+         */
+        size_t readBulk(uint16_t &from);
+
         /**
          *  Set a unique nodeID for this node. This value is stored in program memory, so is saved after loss of power.
          *
          *  This should be called before mesh.begin(), or set via serial connection or other methods if configuring a large number of nodes...
          *  @note If using RF24Gateway and/or RF24Ethernet, nodeIDs 0 & 1 are used by the master node.
+         *  @note A MasterMesh is always nodeID 0 and ignores this.
          *
          *  @param[in]  nodeID      Can be any unique value ranging from 1 to 255.
          *  @return void
@@ -85,7 +748,9 @@ namespace RF24Mesh
 
         /**
          *  Only to be used on the master node. Provides automatic configuration for sensor nodes, similar to DHCP.
-         *  Call immediately after calling network.update() to ensure address requests are handled appropriately.
+         *  Call after each mesh.update(). Requests are collected by update() and answered here without blocking,
+         *  with up to MESH_MAX_PENDING_OFFERS exchanges in flight at once. Confirmations are handled by update(),
+         *  and all other traffic is left for the application.
          *
          *  @return void
          */
@@ -96,6 +761,7 @@ namespace RF24Mesh
         *
         *   @param[in]  address     If no address is provided, returns the local nodeID, otherwise a lookup request is sent to the master node
         *   @return Returns the unique identifier (1-255) or -1 if not found.
+        *   @note update() keeps running while waiting on the master's reply, so other traffic is still handled.
         */
         int16_t getNodeID(const uint16_t address = MESH_BLANK_ID);
 
@@ -108,6 +774,36 @@ namespace RF24Mesh
          */
         bool checkConnection();
 
+        /**
+         *  Start a non-blocking connection probe. The master is asked for this node's own address, which
+         *  measures the round trip and confirms the address is still assigned. The reply (or its absence)
+         *  is picked up by update() and folded into getLinkQuality(), with the smoothing used by TCP
+         *  (RFC 6298) for the round trip time and an exponential average for loss.
+         *
+         *  @return False if a probe is still outstanding or this node has no address
+         */
+        bool probeConnection();
+
+        /**
+         *  @return True while a probe started with probeConnection() waits for its reply
+         */
+        bool probePending() const;
+
+        /**
+         *  @param[out] quality     Receives the current estimates
+         *  @return void
+         */
+        void getLinkQuality(LinkQuality &quality) const;
+
+        /**
+         *  Decide from the probe results whether renewing the address is worthwhile: after
+         *  MESH_PROBE_FAILURES lost probes in a row, when smoothed loss passes MESH_PROBE_MAX_LOSS,
+         *  or once the master has reassigned this node's address.
+         *
+         *  @return True if the address should be renewed
+         */
+        bool shouldRenew() const;
+
         /**
          *  Reconnect to the mesh and renew the current RF24Network address. Used to re-establish a connection to the mesh
          *  if physical location etc. has changed, or a routing node goes down.
@@ -123,85 +819,585 @@ namespace RF24Mesh
         uint16_t renewAddress(const uint32_t timeout = MESH_RENEWAL_TIMEOUT);
 
         /**
-         *  Releases the currently assigned address lease. Useful for nodes that will be sleeping etc.
-         *
-         *  @note Nodes should ensure that addresses are releases successfully prior to renewal.
+         *  Start renewing the address without blocking. The poll, request and confirm exchanges are
+         *  driven forward by each call to update(), which must keep being called until renewalStatus()
+         *  reports COMPLETE or FAILED.
          *
-         *  @return Returns true if successfully released, false if not
+         *  @param[in]  timeout     How long to attempt address renewal in milliseconds default:60000
+         *  @return True if the renewal was started, false if the radio still holds unread data
          */
-        bool releaseAddress();
+        bool beginRenewal(const uint32_t timeout = MESH_RENEWAL_TIMEOUT);
 
         /**
-         * Convert a nodeID into an RF24Network address (octal). This results in a lookup request being sent to the master node.
+         *  Check on a renewal started with beginRenewal() or renewAddress()
          *
-         * @param[in]   nodeID      The unique identifier (1-255) of the node
-         * @return RF24Network address of the node or -1 if not found or lookup failed.
+         *  @return The current state of the renewal
          */
-        int16_t getAddress(const uint8_t nodeID);
+        RenewalState renewalStatus() const;
 
         /**
-         *  Write to a specific node by RF24Network address.
+         *  Register a function to be called from update() when a renewal finishes
          *
-         *  @param[in]  node        The node to write to
-         *  @param[in]  data        The data to be written
-         *  @param[in]  size        The length of the data
+         *  @param[in]  callback    The function to call, or nullptr to remove it
+         *  @return void
          */
-        bool writeTo(const uint16_t node, const void *const data, const uint8_t msg_type, const size_t size);
+        void setRenewalCallback(const RenewalCallback callback);
 
         /**
-         *  Change the active radio channel after the mesh has been started.
+         *  Master only. Replace the rule that decides where joining nodes are placed. Nodes send the other
+         *  parents they heard during their poll sweep, and the master rates each of them together with the
+         *  node that relayed the request. By default shallow parents with few children win.
          *
-         *  @param[in]  channel     The new channel to be set
+         *  @param[in]  policy      The rating function, or nullptr for the default
          *  @return void
          */
-        void setChannel(uint8_t channel);
+        void setAllocationPolicy(const AllocationPolicy policy);
 
         /**
-         *  Allow child nodes to discover and attach to this node.
+         *  The master answers lease renewals with a hint when a clearly better parent was heard. The
+         *  next renewal favours that parent, so call renewAddress() at a convenient time to move.
          *
-         *  @param[in]  allow       True to allow children, False to prevent children from attaching automatically
+         *  @return The suggested parent, or MESH_DEFAULT_ADDRESS if there is no better one
          */
-        void setChild(const bool allow);
+        uint16_t rehomeHint() const;
 
         /**
-         *  Set/change a nodeID/RF24Network Address pair manually on the master node.
-         *  TODO: Does this mean the master is keeping track of who is on the network? I guess so...
+         *  Releases the currently assigned address lease. Nodes that sleep for less than half of MESH_LEASE_TIME
+         *  should use sleep() and wake() instead, which keep the address.
          *
-         *  @param[in]  nodeID      The nodeID to assign
-         *  @param[in]  address     The octal RF24Network address to assign
-         *  @return void
+         *  @note Nodes should ensure that addresses are releases successfully prior to renewal.
+         *
+         *  @return Returns true if successfully released, false if not
          */
-        void setAddress(const uint8_t nodeID, const uint16_t address);
+        bool releaseAddress();
 
         /**
-        *   TODO
-        */
-        void saveDHCP();
+         *  Tells the parent this node is going to sleep, then powers the radio down. The node keeps its
+         *  address, and the parent holds messages sent with writeMail() until wake() collects them.
+         *
+         *  @param[in]  duration    How long the node expects to sleep in milliseconds
+         *  @return True if the parent received the notice
+         */
+        bool sleep(const uint32_t duration);
 
         /**
-        *   TODO
-        */
-        void loadDHCP();
+         *  Powers the radio back up after sleep() and collects the messages the parent held, which
+         *  takes a single exchange rather than a renewal.
+         *
+         *  @param[in]  timeout     How long to wait for the parent to hand the messages over
+         *  @return The number of messages collected, read them with readMail()
+         */
+        uint8_t wake(const uint16_t timeout = MESH_WAKE_WINDOW);
 
-        uint16_t mesh_address; /**< The assigned RF24Network (Octal) address of this node */
+        /**
+         *  Send a message that the destination's parent holds while the destination sleeps. If the
+         *  destination is awake, the parent passes it on straight away.
+         *
+         *  @param[in]  nodeID      The nodeID of the recipient
+         *  @param[in]  data        The message
+         *  @param[in]  msg_type    The user message type (1-127) reported by readMail()
+         *  @param[in]  size        Length of the message, at most MESH_MAIL_PAYLOAD_SIZE
+         *  @return True if the parent received the message
+         */
+        bool writeMail(const uint8_t nodeID, const void *const data, const uint8_t msg_type, const size_t size);
 
-        struct AddressList
-        {
-            uint8_t nodeID;
-            uint16_t address;
-        };
+        /**
+         *  @return True if a message delivered by the parent is waiting to be read
+         */
+        bool mailAvailable() const;
 
-        uint8_t addrListTop;      /**< The number of entries in the assigned address list */
-        AddressList *addressList; /**< Pointer used for dynamic memory allocation of address list*/
+        /**
+         *  Take the oldest message delivered by the parent
+         *
+         *  @param[out] header      Receives the original sender as from_node and the message type
+         *  @param[out] message     Receives the message
+         *  @param[in]  maxlen      Size of message
+         *  @return The length of the message, 0 if none was waiting
+         */
+        uint16_t readMail(RF24Network::Header &header, void *const message, const uint16_t maxlen);
 
-    private:
-        bool doDHCP;    /**< Indicator that an address request is available */
-        uint8_t nodeID; /**< TODO */
+        /**
+         *  Capture what is needed to reattach quickly after a reset. Renewals first ask the master whether
+         *  the previous address is still assigned to this node, and only poll for a new one if it isn't.
+         *  Store the state somewhere that survives the reset (EEPROM, RTC memory, a file) and hand it back
+         *  with setReconnectState() before begin().
+         *
+         *  @param[out] state       Receives the state
+         *  @return False if this node has never held an address
+         */
+        bool getReconnectState(ReconnectState &state) const;
+
+        /**
+         *  Restore state captured with getReconnectState()
+         *
+         *  @param[in]  state       The saved state
+         *  @return False if the state is corrupt or belongs to another nodeID, in which case it is ignored
+         */
+        bool setReconnectState(const ReconnectState &state);
+
+        /**
+         * Convert a nodeID into an RF24Network address (octal). This results in a lookup request being sent to the master node.
+         *
+         * @param[in]   nodeID      The unique identifier (1-255) of the node
+         * @return RF24Network address of the node or -1 if not found or lookup failed.
+         */
+        int16_t getAddress(const uint8_t nodeID);
+
+        /**
+         *  Convert several nodeIDs into RF24Network addresses at once. Up to MESH_MAX_BATCH_LOOKUP IDs
+         *  are resolved by each request to the master, and IDs already in the lookup cache are not sent.
+         *
+         *  @param[in]   ids         The unique identifiers (1-255) of the nodes
+         *  @param[in]   n           Number of entries in ids and out
+         *  @param[out]  out         Address of each node, or -1 if not found or the lookup failed
+         *  @return The number of IDs that were resolved
+         */
+        size_t getAddresses(const uint8_t *const ids, const size_t n, int16_t *const out);
+
+        /**
+         *  Drop a remembered nodeID to address lookup so the next write to that node asks the master again.
+         *
+         *  @param[in]   nodeID      The unique identifier (1-255) of the node
+         *  @return void
+         */
+        void invalidateAddress(const uint8_t nodeID);
+
+        /**
+         *  Drop every remembered nodeID to address lookup
+         *
+         *  @return void
+         */
+        void clearAddressCache();
+
+        /**
+         *  Ask the master to push address changes to this node. Remembered lookups are then kept up to date
+         *  by the master and no longer expire, so repeat writes stop generating lookup traffic. If a change
+         *  notification is missed, every remembered lookup is dropped.
+         *
+         *  @param[in]  enable      False to cancel the subscription
+         *  @return True if the request was sent to the master
+         */
+        bool subscribeAddresses(const bool enable = true);
+
+        /**
+         *  Run this node as a standby master. It joins the mesh like any other node (ideally as a direct child
+         *  of the master), then keeps a copy of the master's address table from a full sync plus the master's
+         *  change notifications. If the master stops answering for MESH_STANDBY_MISSES * MESH_STANDBY_INTERVAL
+         *  it takes over as nodeID 0 at address 00 and starts serving lookups and DHCP from its copy.
+         *
+         *  @note Call before begin(). Keep calling DHCP() on the standby so it can serve requests once promoted.
+         *  @note A standby must not call renewAddress() when checkConnection() fails, since losing the master
+         *  is exactly what it is waiting for. The old master should rejoin as the new standby.
+         *  @note Only a Mesh can be a standby, since it has to switch roles at runtime.
+         *
+         *  @param[in]  enable      True to act as a standby master
+         *  @return void
+         */
+        void setStandby(const bool enable);
+
+        /**
+         *  @return True while this node is waiting to take over as the master
+         */
+        bool isStandby() const;
+
+        /**
+         *  Register a function to be called when a standby master takes over
+         *
+         *  @param[in]  callback    The function to call, or nullptr to remove it
+         *  @return void
+         */
+        void setPromotionCallback(const PromotionCallback callback);
+
+        /**
+         *  Write to a specific node by RF24Network address.
+         *
+         *  @param[in]  node        The node to write to
+         *  @param[in]  data        The data to be written
+         *  @param[in]  size        The length of the data
+         */
+        bool writeTo(const uint16_t node, const void *const data, const uint8_t msg_type, const size_t size);
+
+        /**
+         *  Change the active radio channel after the mesh has been started.
+         *
+         *  @param[in]  channel     The new channel to be set
+         *  @return void
+         */
+        void setChannel(uint8_t channel);
+
+        /**
+         *  Master only: move the whole mesh to another channel. The announcement is passed down the tree by
+         *  every routing node, and each node switches once the delay has passed, counted from when it heard
+         *  the announcement. Addresses and leases are kept, so no node has to renew.
+         *
+         *  @note Nodes that are asleep or out of contact for the whole delay stay behind, and renew on the new channel.
+         *
+         *  @param[in]  channel     The new channel (1-127)
+         *  @param[in]  delay       How long from now the switch happens in milliseconds
+         *  @return False if this node isn't the master or the channel is out of range
+         */
+        bool switchChannel(const uint8_t channel, const uint16_t delay = MESH_SWITCH_DELAY);
+
+        /**
+         *  @return The channel a scheduled switch will move to, 0 if none is scheduled
+         */
+        uint8_t pendingChannel() const;
+
+        /**
+         *  Allow child nodes to discover and attach to this node. A LeafMesh never allows children.
+         *
+         *  @param[in]  allow       True to allow children, False to prevent children from attaching automatically
+         */
+        void setChild(const bool allow);
+
+        /**
+         *  Set/change a nodeID/RF24Network Address pair manually on the master node.
+         *  TODO: Does this mean the master is keeping track of who is on the network? I guess so...
+         *
+         *  @param[in]  nodeID      The nodeID to assign
+         *  @param[in]  address     The octal RF24Network address to assign
+         *  @param[in]  permanent   True if the address should never expire, even if the node doesn't renew its lease
+         *  @return void
+         */
+        void setAddress(const uint8_t nodeID, const uint16_t address, const bool permanent = false);
+
+        /**
+        *   Rewrites the DHCP journal on Linux masters so it holds a single record per entry in the address
+        *   list. This is done automatically once the journal has grown well past the size of the table.
+        *
+        *   @return void
+        */
+        void saveDHCP();
+
+        /**
+        *   Rebuilds the address list on Linux masters by replaying the DHCP journal. A table saved in the
+        *   format of older releases is imported and converted to a journal. Permanent entries stay permanent,
+        *   and leases and holds resume with the time they had left when they were journaled.
+        *
+        *   @return void
+        */
+        void loadDHCP();
+
+        /**
+        *   Route application frames to handlers instead of polling network.available(). Each call to
+        *   update() hands queued frames to their handlers until it meets one whose type has none,
+        *   which is left in the queue for the application to read.
+        *
+        *   @param[in]  table       A table built with makeDispatchTable(), or nullptr to stop dispatching.
+        *                           It must outlive its use by the mesh.
+        */
+        void setDispatchTable(const DispatchTable *const table);
+
+        /**
+        *   View the frame most recently received by the network layer, without copying it.
+        *   Control messages handled by the mesh can be parsed this way as well as application frames.
+        *
+        *   @return A view of the frame buffer
+        */
+        FrameView currentFrame() const;
+
+        /**
+        *   Check whether a view still describes the frame in the buffer
+        *
+        *   @param[in]  frame       A view returned by currentFrame()
+        *   @return True if no other frame has been received since the view was taken
+        */
+        bool isCurrent(const FrameView &frame) const;
+
+        /**
+        *   Copy the mesh counters. All zero if MESH_ENABLE_STATS is not set.
+        *   The copy is consistent, and safe to take from another thread while update() runs.
+        *
+        *   @param[out] out         Receives the counters, left untouched if they stayed busy
+        *   @return The version of the counters, which changes whenever any of them does. An odd version means no
+        *   consistent copy could be taken in MESH_SNAPSHOT_RETRIES tries.
+        */
+        uint32_t getStats(Stats &out) const;
+
+        /**
+        *   Set all mesh counters back to zero
+        *
+        *   @return void
+        */
+        void resetStats();
+
+        /**
+         *  Copy the trace events recorded since `cursor`, oldest first. Events overwritten before they were
+         *  read are skipped. Nothing is recorded unless MESH_ENABLE_TRACE is set.
+         *
+         *  @note Call from the thread running update(), between calls.
+         *
+         *  @param[out]     out         Receives the events
+         *  @param[in]      max         Number of events out can hold
+         *  @param[in,out]  cursor      Start at 0, then pass the same variable back to carry on where the last read stopped
+         *  @return The number of events copied
+         */
+        uint16_t readTrace(TraceRecord *const out, const uint16_t max, uint32_t &cursor) const;
+
+        /**
+         *  @return Events recorded since the mesh was created, including any that were overwritten
+         */
+        uint32_t traceCount() const;
+
+        uint16_t mesh_address; /**< The assigned RF24Network (Octal) address of this node */
+
+        using AddressList = RF24Mesh::AddressList;
+
+        uint8_t addrListTop;      /**< The number of entries in the assigned address list */
+        AddressList *addressList; /**< Storage of the assigned address list, sized once in begin() or by setAddressStorage() */
+
+        /**
+        *   Supply the memory the master uses for its address list. Should be called before begin(), as the
+        *   table starts out empty in the new storage.
+        *   Without this, begin() reserves MESH_ADDRESS_POOL_SIZE entries once, either statically or
+        *   from the heap depending on MESH_STATIC_ADDRESS_POOL. The table never grows afterwards.
+        *   @note The static pool is shared by every mesh of the same role, so a program running more than one
+        *   master capable mesh (a master and a standby, say) must give all but one of them their own storage.
+        *
+        *   @param[in]  storage     Array the address list will live in, owned by the caller
+        *   @param[in]  capacity    Number of entries in storage
+        *   @return void
+        */
+        void setAddressStorage(AddressList *const storage, const uint8_t capacity);
+
+        /**
+        *   Master only. Copy the address table, for monitors running on another thread than update() and DHCP().
+        *   The radio loop never waits on a copy, and a copy never mixes entries from before and after a change.
+        *   Reading addressList directly is only safe from the thread running the mesh.
+        *
+        *   @param[out] out         Receives the entries
+        *   @param[in]  max         Number of entries out can hold
+        *   @param[out] version     **Optional**: Receives the version of the table that was copied. It is odd if the table
+        *   was being changed for all MESH_SNAPSHOT_RETRIES tries, for instance because the master died part way through.
+        *   @return The number of entries copied, 0 if the table stayed busy
+        */
+        uint8_t snapshotTable(AddressList *const out, const uint8_t max, uint32_t *const version = nullptr) const;
+
+        /**
+        *   @return The version of the address table, which changes whenever an entry does. Cheap enough
+        *   to poll, so a monitor only needs to call snapshotTable() when it moves. Odd while a change is in progress.
+        */
+        uint32_t tableVersion() const;
+
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+        /**
+        *   Linux masters only. Places the address list in a shared memory mapped file, so every change is
+        *   persisted by the kernel and the table survives restarts without being replayed. Called by
+        *   loadDHCP() when MESH_DHCP_USE_MMAP is set.
+        *
+        *   @param[in]  path        The file backing the table
+        *   @return True if the table is now mapped
+        */
+        bool mapDHCP(const char *const path = MESH_DHCP_MAP);
+
+        /**
+        *   Linux only. Maps an address table written by mapDHCP() read-only, so other processes such as
+        *   monitors can read the live table without touching the radio. Entries flagged MESH_LEASE_RELEASED no longer resolve.
+        *
+        *   @param[in]  path        The file backing the table
+        *   @return The header of the table, or nullptr if the file is missing or not a table
+        */
+        static const DHCPMapHeader *viewDHCP(const char *const path = MESH_DHCP_MAP);
+
+        /**
+        *   The entries that follow a mapped table header
+        *
+        *   @param[in]  map         A header returned by viewDHCP()
+        *   @return The first of map->capacity entries
+        */
+        static const AddressList *mappedEntries(const DHCPMapHeader *const map)
+        {
+            return reinterpret_cast<const AddressList *>(map + 1);
+        }
+
+        /**
+        *   Linux only. As snapshotTable(), for a table mapped by viewDHCP(). Reading mappedEntries()
+        *   directly can catch the master part way through a change.
+        *
+        *   @param[in]  map         A header returned by viewDHCP()
+        *   @param[out] out         Receives the entries
+        *   @param[in]  max         Number of entries out can hold
+        *   @param[out] version     **Optional**: Receives the version of the table that was copied, odd if it stayed busy
+        *   @return The number of entries copied, 0 if the table stayed busy
+        */
+        static uint8_t snapshotDHCP(const DHCPMapHeader *const map, AddressList *const out, const uint8_t max, uint32_t *const version = nullptr);
+#endif
+
+    private:
+        /**
+        *   Master only lookup indices into addressList. Both hold the position of the
+        *   entry in addressList, or MESH_INVALID_SLOT if there is no such entry.
+        */
+        static constexpr uint16_t NodeSlots = Role::master ? 256 : 1;
+        static constexpr uint16_t AddressSlots = Role::master ? MESH_ADDRESS_INDEX_SIZE : 1;
+        static constexpr uint8_t OfferSlots = Role::master ? MESH_MAX_PENDING_OFFERS : 1;
+        static constexpr uint8_t ProxySlots = Role::routing ? MESH_MAX_PROXIED_LOOKUPS : 1;
+        static constexpr uint8_t QueueSlots = Role::routing ? MESH_SEND_QUEUE_SIZE : MESH_LEAF_SEND_QUEUE_SIZE;
+        static constexpr uint8_t CacheSlots = Role::routing ? MESH_LOOKUP_CACHE_SIZE : MESH_LEAF_LOOKUP_CACHE_SIZE;
+        static constexpr bool BulkEnabled = Role::routing || MESH_LEAF_BULK;
+
+        static_assert(QueueSlots, "The send queue needs at least one slot");
+
+        uint8_t nodeSlot[NodeSlots];                    /**< Indexed directly by nodeID */
+        uint8_t addressSlot[AddressSlots];              /**< Indexed by the octal level/slot of an address, see addressToIndex() */
+
+        struct CachedAddress
+        {
+            uint8_t nodeID;
+            uint16_t address;
+            uint32_t fetched;  /**< When the master returned this address */
+            uint32_t lastUsed; /**< When this entry last satisfied a write, used to evict the least recently used */
+        };
+
+        CachedAddress addressCache[CacheSlots ? CacheSlots : 1];
+
+        /*------------------------------------------------
+        Address change notifications
+        ------------------------------------------------*/
+        struct AddressDelta
+        {
+            uint8_t nodeID;
+            uint16_t address;   /**< 0 if the node released its address */
+        };
+
+        uint8_t subscribers[Role::master ? 256 / 8 : 1]; /**< Master: nodeIDs receiving MESH_ADDR_CHANGED, one bit each */
+        uint8_t subscriberCount;
+        AddressDelta pendingDeltas[Role::master ? MESH_MAX_DELTAS : 1]; /**< Master: changes not yet pushed */
+        uint8_t pendingDeltaCount;
+        uint8_t deltaSequence;                          /**< Master: next sequence to send. Node: next sequence expected. */
+        bool subscribed;
+        bool deltaSynced;                               /**< Node: deltaSequence is known */
+        uint32_t lastSubscribe;
+
+        /*------------------------------------------------
+        Lookups relayed for children (MESH_LOOKUP_VIA_PARENT)
+        ------------------------------------------------*/
+        struct ProxiedLookup
+        {
+            uint8_t nodeID;     /**< 0 if the entry is free */
+            uint16_t requester;
+            uint32_t sent;
+        } proxied[ProxySlots];
+        uint8_t parentLookupMisses; /**< Lookups in a row the parent left unanswered */
+
+        /*------------------------------------------------
+        Standby master
+        ------------------------------------------------*/
+        bool standby;
+        bool syncing;                   /**< A full table sync is in progress */
+        uint32_t lastMasterContact;     /**< When the master was last heard from */
+        uint32_t lastStandbyCheck;
+        PromotionCallback promotionCallback;
+
+        enum class OfferState : uint8_t
+        {
+            FREE,      /**< Entry is unused */
+            REQUESTED, /**< A request arrived and is waiting to be answered by DHCP() */
+            OFFERED    /**< An address was offered and is waiting on MESH_ADDR_CONFIRM */
+        };
+
+        struct Offer
+        {
+            OfferState state;
+            uint8_t nodeID;     /**< The node asking for an address */
+            uint16_t requester; /**< Where the request came from, either the contact node or MESH_DEFAULT_ADDRESS */
+            uint16_t address;   /**< The address offered */
+            uint32_t timer;     /**< When the entry entered its current state */
+            uint16_t alternates[MESH_MAX_POLLS - 1]; /**< Other parents the requester heard */
+            uint8_t alternateCount;
+        };
+
+        AllocationPolicy allocationPolicy;
+        uint16_t hintedParent;  /**< Node: see rehomeHint() */
+
+        static int16_t defaultAllocationCost(const ParentCandidate &candidate);
+
+        /**
+        *   Rates a parent for a node with the allocation policy
+        *
+        *   @param[in]  parent      The candidate parent
+        *   @param[in]  contact     True if the parent relayed the request
+        *   @param[in]  from_id     The node being placed, whose own address doesn't count against the parent
+        *   @return The cost, or -1 if the parent can't take the node
+        */
+        int16_t parentCost(const uint16_t parent, const bool contact, const uint8_t from_id);
+
+        /**
+        *   Writes the contact list read by readContacts(): a count tagged with MESH_CONTACT_MARKER,
+        *   then the addresses of the parents heard in the last poll sweep
+        *
+        *   @param[out] payload     At least 1 + 2 * (MESH_MAX_POLLS - 1) bytes
+        *   @param[in]  exclude     The parent being used, left out of the list
+        *   @return The number of bytes written
+        */
+        uint8_t writeContacts(uint8_t *const payload, const uint16_t exclude) const;
+
+        /**
+        *   @param[out] contacts    Receives up to MESH_MAX_POLLS - 1 addresses
+        *   @return The number of contacts, 0 if the frame carries no list
+        */
+        static uint8_t readContacts(const FrameView &frame, uint16_t *const contacts);
+
+        Offer offers[OfferSlots];
+
+        StatsRecorder<MESH_ENABLE_STATS> stats;
+        TraceRecorder<MESH_ENABLE_TRACE> traceRing;
+
+        /**
+         *  Records an event in the trace ring. Compiled out, including the timestamp, unless MESH_ENABLE_TRACE is set.
+         */
+        void trace(const TraceEvent event, const uint16_t address, const uint8_t nodeID);
+        uint32_t frameSequence;   /**< Incremented whenever network.update() processes a frame */
+        uint8_t batchSequence;    /**< Sent in the reserved byte of batch lookups and echoed by the master's reply */
+        uint8_t idLookupSequence; /**< As batchSequence, for getNodeID() */
+        const DispatchTable *dispatch;
+
+        bool doDHCP;    /**< Indicator that an address request is available */
+        uint8_t nodeID; /**< TODO */
         uint8_t radio_channel;
-        uint16_t lastID;
-        uint16_t lastAddress;
         uint32_t lastSaveTime;
-        uint32_t lastFileSave;
+
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+        /**
+        *   One appended change to the address list, the entry as it stands after the change.
+        *   A record with address MESH_DEFAULT_ADDRESS removes the entry.
+        */
+        struct JournalRecord
+        {
+            uint32_t sequence;  /**< Increases by one with every record, across compactions */
+            uint32_t remaining; /**< Milliseconds left on the lease or hold when the record was written */
+            uint16_t address;
+            uint8_t nodeID;
+            uint8_t flags;      /**< MESH_LEASE_RELEASED, MESH_LEASE_PERMANENT */
+            uint8_t version;    /**< MESH_JOURNAL_VERSION */
+            uint8_t crc;        /**< CRC-8 of the fields above */
+            uint8_t padding[2];
+        };
+
+#endif
+
+        /**
+        *   Bookkeeping of the master's address list, kept only by roles that can be the master
+        */
+        struct DHCPState
+        {
+            uint8_t addrListCapacity;   /**< Number of entries addressList can hold */
+            bool userAddressStorage;    /**< addressList was supplied through setAddressStorage() */
+            uint8_t leaseCursor;        /**< The next addressList entry reclaimLeases() checks */
+            uint32_t lastFileSave;      /**< When the DHCP journal was last flushed to storage */
+
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+            int journalFd;              /**< Open append handle of the journal, or -1 */
+            uint32_t journalSequence;   /**< Sequence number of the last record written or replayed */
+            uint16_t journalRecords;    /**< Records currently in the journal */
+            bool journalDirty;          /**< Records were appended since the last fsync */
+
+            DHCPMapHeader *dhcpMap;     /**< The mapped table when mapDHCP() is in use */
+            size_t dhcpMapSize;         /**< Length of the mapping */
+#endif
+        };
+
+        RoleStorage<DHCPState, Role::master> dhcp;
 
         RF24Network::Network &network;
         NRF24L::NRF24L01 &radio;
@@ -216,13 +1412,383 @@ namespace RF24Mesh
          */
         bool findNodes(RF24Network::Header &header, uint8_t level, uint16_t *address);
 
+        struct Renewal
+        {
+            RenewalState state;
+            RenewalCallback callback;
+            uint32_t start;     /**< When the renewal began */
+            uint32_t timeout;   /**< How long the renewal may take overall */
+            uint32_t timer;     /**< When the current step began */
+            uint32_t wait;      /**< How long the current step waits before acting */
+            bool sent;          /**< The current step has transmitted its frame */
+            uint8_t level;      /**< Multicast level of the current poll sweep */
+            uint8_t totalReqs;  /**< Sweeps attempted, used to grow the backoff */
+            uint8_t pollCount;  /**< Poll responses collected this sweep */
+            uint8_t contact;    /**< Index of the contact node being asked for an address */
+            uint8_t attempts;   /**< Confirmation writes attempted */
+            uint16_t contactNode[MESH_MAX_POLLS];
+            int8_t contactScore[MESH_MAX_POLLS]; /**< Link quality of each contact node, higher is tried first */
+        } renewal;
+
+        struct Probe
+        {
+            bool active;
+            uint32_t sent;
+            uint16_t srtt8;     /**< srtt in 1/8 ms */
+            uint16_t rttvar4;   /**< rttvar in 1/4 ms */
+            uint16_t loss256;   /**< Loss in 1/256ths, scaled by 8 for the average */
+            uint8_t consecutiveLosses;
+            uint16_t samples;
+            bool addressLost;
+        } probe;
+
         /**
-         *  Actual requesting of the address once a contact node is discovered or supplied
+         *  Folds a probe outcome into the estimates
          *
-         *  @param[in]  level       TODO
-         *  @return TODO
+         *  @param[in]  answered    False if the probe timed out
+         *  @param[in]  rtt         Measured round trip in ms, if answered
+         */
+        void finishProbe(const bool answered, const uint32_t rtt);
+
+        uint16_t probeTimeout() const;
+
+        struct ChannelSwitch
+        {
+            bool pending;
+            uint8_t sequence;   /**< Identifies the announcement, so repeats of it are ignored */
+            uint8_t channel;
+            uint8_t repeats;    /**< Announcements still to send to the level below */
+            uint32_t at;        /**< When to switch */
+            uint32_t nextRepeat;
+        } channelSwitch;
+
+        /**
+         *  Schedules the switch announced by the level above, unless it is a repeat of the pending one
+         */
+        void acceptChannelSwitch(const FrameView &frame);
+
+        /**
+         *  Passes a pending switch on to the level below and switches once it is due
+         */
+        void serviceChannelSwitch();
+
+        uint16_t lastAddress;   /**< Address to try reattaching with, MESH_DEFAULT_ADDRESS if none */
+        uint8_t lastChannel;
+
+        /*------------------------------------------------
+        Sleeping nodes
+        ------------------------------------------------*/
+        struct Mail
+        {
+            uint16_t to;        /**< Routing node: the sleeping child, 0 if the entry is free */
+            uint16_t from;
+            uint8_t type;
+            uint8_t length;
+            uint32_t stored;
+            uint8_t data[MESH_MAIL_PAYLOAD_SIZE];
+        };
+
+        struct Sleeper
+        {
+            uint16_t address;   /**< 0 if the entry is free */
+            uint32_t until;     /**< When the child is no longer treated as asleep */
+        };
+
+        Mail mailbox[Role::routing ? MESH_MAILBOX_SLOTS : 1];  /**< Routing node: messages held for sleeping children */
+        Sleeper sleepers[Role::routing ? MESH_MAX_SLEEPERS : 1];
+        Mail inbox[Role::node ? MESH_MAIL_INBOX : 1];           /**< Node: delivered messages, oldest at inboxHead */
+        uint8_t inboxHead;
+        uint8_t inboxCount;
+
+        /**
+         *  Routing node: records sleeping children, and holds or hands over their messages
+         *
+         *  @param[in]  type        The type of the frame update() just read
+         */
+        void serviceMailbox(const uint8_t type);
+
+        /**
+         *  Routing node: holds a message for a sleeping child, or passes it on if the child is awake
+         *
+         *  @return False if the message could neither be held nor sent
+         */
+        bool depositMail(const uint16_t to, const uint16_t from, const uint8_t type, const uint8_t *const data, const uint8_t length);
+
+        /**
+         *  Routing node: sends one message to a child in a MESH_MAIL_DELIVER frame
+         *
+         *  @param[in]  remaining   How many more messages follow this one
+         */
+        bool deliverMail(const Mail &mail, const uint8_t remaining);
+
+        /**
+         *  Routing node: finds the sleeper entry of a child that is still asleep
+         *
+         *  @return The entry, or nullptr if the child is awake
+         */
+        Sleeper *findSleeper(const uint16_t address);
+
+        /**
+         *  Node: stores a MESH_MAIL_DELIVER frame in the inbox
+         *
+         *  @return True if it was the last message the parent had
+         */
+        bool acceptMail(const FrameView &frame);
+
+        uint32_t leaseRenewed;  /**< When the master last confirmed this node's lease */
+        uint32_t leaseSent;     /**< When the last MESH_ADDR_RENEW went out */
+
+        /**
+         *  Asks the master to extend this node's lease once half of it has passed,
+         *  and checks the answer
+         *
+         *  @param[in]  type        The type of the frame update() just read
+         */
+        void renewLease(const uint8_t type);
+
+        static uint8_t reconnectCheck(const ReconnectState &state);
+
+        struct QueuedWrite
+        {
+            SendStatus status;
+            uint8_t generation;     /**< Distinguishes successive uses of the slot in handles */
+            uint8_t nodeID;
+            uint8_t type;
+            uint16_t length;
+            uint8_t attempts;       /**< Failed transmissions so far */
+            uint32_t start;
+            uint32_t timeout;
+            uint32_t nextAttempt;   /**< Earliest time of the next transmission */
+            SendCallback callback;
+            uint8_t payload[MESH_FRAME_PAYLOAD_SIZE];
+        } sendQueue[QueueSlots];
+
+        struct QueueLookup
+        {
+            bool active;        /**< Waiting on the reply */
+            bool answered;      /**< `address` holds the reply for `nodeID` */
+            uint8_t nodeID;
+            int16_t address;
+            uint32_t sent;
+        } queueLookup;      /**< The one address lookup the send queue may have outstanding */
+
+        uint32_t jitterState;   /**< Random state for the retry jitter */
+
+        static_assert(MESH_BULK_WINDOW && (MESH_BULK_WINDOW <= 32), "MESH_BULK_WINDOW must fit the 32 bit acknowledgement");
+        static_assert(MESH_BULK_BURST && (MESH_BULK_BURST <= MESH_BULK_WINDOW), "MESH_BULK_BURST can't exceed MESH_BULK_WINDOW");
+
+        struct BulkSend
+        {
+            SendStatus status;
+            uint8_t id;             /**< Changes with every transfer so the receiver can tell them apart */
+            uint8_t nodeID;
+            int16_t address;        /**< The resolved destination, -1 while unknown */
+            const uint8_t *data;
+            uint32_t size;
+            uint16_t fragments;
+            uint16_t base;          /**< First fragment not yet acknowledged */
+            uint32_t acked;         /**< Fragments from base on that were acknowledged, one bit each */
+            uint32_t sent;          /**< Fragments from base on that are sent and not known to be lost */
+            uint8_t attempts;       /**< Failed writes in a row */
+            uint32_t start;
+            uint32_t timeout;
+            uint32_t nextAttempt;   /**< Earliest time of the next write after a failure */
+            uint32_t lastAck;       /**< When the receiver last acknowledged, or was last asked to */
+            SendCallback callback;
+        };
+
+        RoleStorage<BulkSend, BulkEnabled> bulkOut;
+
+        struct BulkReceive
+        {
+            uint8_t *buffer;
+            uint32_t capacity;
+            bool complete;          /**< buffer holds a transfer until readBulk() */
+            bool ackPending;        /**< Fragments arrived that haven't been acknowledged */
+            uint8_t id;
+            uint16_t from;          /**< The sender, MESH_DEFAULT_ADDRESS if nothing was received yet */
+            uint32_t size;
+            uint16_t fragments;
+            uint16_t base;          /**< First fragment not yet received */
+            uint16_t highest;       /**< Highest fragment index received */
+            uint32_t received;      /**< Fragments from base on that were received, one bit each */
+            uint32_t lastFragment;
+        };
+
+        RoleStorage<BulkReceive, BulkEnabled> bulkIn;
+
+        /**
+         *  Advances both directions of bulk transfer. Called from update() with the result of network.update().
+         */
+        void serviceBulk(const uint8_t type);
+
+        /**
+         *  Sends the next burst of fragments that are in the window and not in flight. The last one asks
+         *  the receiver for an acknowledgement.
          */
-        bool requestAddress(uint8_t level);
+        void sendFragments(const uint32_t now);
+
+        void acceptBulkAck(const FrameView &frame);
+        void acceptFragment(const FrameView &frame);
+
+        /**
+         *  Reports the contiguous and selective progress of the incoming transfer
+         *
+         *  @param[in]  to          The sender
+         *  @param[in]  id          The transfer being acknowledged
+         *  @param[in]  refused     Tells the sender the transfer can't be taken, rather than its progress
+         */
+        void sendBulkAck(const uint16_t to, const uint8_t id, const bool refused);
+
+        void finishBulk(const SendStatus status);
+
+        /**
+         *  Runs the network layer once. Every mesh call into network.update() goes through here so
+         *  frame views can tell when the frame buffer has been overwritten.
+         *
+         *  @return The type of the frame processed, or 0 if none arrived
+         */
+        uint8_t pollNetwork();
+
+        /**
+         *  Answers the mesh control messages received by the master
+         */
+        void handleControl(const uint8_t type, const FrameView &frame);
+
+        /**
+         *  Queues an address change for subscribers, called wherever the master's table changes
+         */
+        void notifyAddress(const uint8_t nodeID, const uint16_t address);
+
+        /**
+         *  Pushes queued address changes to every subscriber
+         */
+        void flushDeltas();
+
+        /**
+         *  Applies a MESH_ADDR_CHANGED frame to the lookup cache
+         */
+        void applyDeltas(const FrameView &frame);
+
+        /**
+         *  @return Where this node sends address lookups: its parent with MESH_LOOKUP_VIA_PARENT, otherwise the master.
+         *  A parent that leaves MESH_PARENT_LOOKUP_MISSES lookups in a row unanswered is probably running firmware
+         *  that doesn't relay them, so the master is asked instead until the node next renews its address.
+         */
+        uint16_t lookupTarget() const;
+
+        /**
+         *  Counts an answered or unanswered lookup against the parent, see lookupTarget()
+         */
+        void countParentLookup(const bool answered);
+
+        /**
+         *  Checks whether a MESH_ADDR_LOOKUP frame is the answer to a lookup of `nodeID` sent by this node.
+         *  Lookup requests echo the nodeID in the reserved header byte, and replies keep it.
+         */
+        bool isLookupReply(const FrameView &frame, const uint8_t nodeID) const;
+
+        /**
+         *  Routing node: answers a child's lookup from the cache, or passes it up and relays the reply
+         */
+        void relayLookup(const FrameView &frame);
+
+        /**
+         *  Master: sends the address table, or just the current change sequence, to a standby
+         */
+        void sendTableSync(const uint16_t to, const bool full);
+
+        /**
+         *  Standby: follows the master and takes over when it stops answering
+         */
+        void serviceStandby(const uint8_t type);
+
+        /**
+         *  Standby: becomes the master using the replicated table
+         */
+        void promote();
+
+        /**
+         *  Reserves memory for the address table unless storage was set with setAddressStorage()
+         */
+        void allocateAddressPool();
+
+        /**
+         *  Hands queued application frames to the dispatch table
+         */
+        void dispatchFrames();
+
+        /**
+         *  Reserves a slot in the send queue
+         *
+         *  @return The slot index, or QueueSlots if the queue is full
+         */
+        uint8_t reserveWrite(const uint8_t msg_type, const size_t size, const uint8_t nodeID, const uint32_t timeout, const SendCallback callback);
+
+        /**
+         *  Advances every queued write. Called from update() with the result of network.update().
+         */
+        void serviceQueue(const uint8_t type);
+
+        /**
+         *  Matches the reply to the queue's address lookup, or expires it
+         */
+        void serviceLookup(const uint8_t type, const uint32_t now);
+
+        /**
+         *  Resolves the destination of a queued write or bulk transfer without blocking
+         *
+         *  @return The address, -1 while a lookup is outstanding, or -2 if the master does not know the node
+         */
+        int16_t resolveQueued(const uint8_t nodeID, const uint32_t now);
+
+        void completeWrite(const uint8_t slot, const SendStatus status);
+
+        /**
+         *  @return True while an address request, offer or lookup this node is part of is waiting on a reply,
+         *  which lower priority writes should not crowd out. Relayed lookups stop counting after MESH_ASYNC_LOOKUP_TIMEOUT.
+         */
+        bool controlPending() const;
+
+        /**
+         *  @return The delay before the next attempt of a write that has failed `attempts` times
+         */
+        uint32_t sendBackoff(const uint8_t attempts);
+
+        /**
+         *  Advances the renewal state machine. Called from update() with the result of network.update().
+         *
+         *  @param[in]  type        The type of the frame just processed by the network layer, if any
+         *  @return void
+         */
+        void stepRenewal(const uint8_t type);
+
+        /**
+         *  Records a poll response as a candidate parent, keeping the candidates sorted best first.
+         *  The score rewards a strong signal (radio RPD) and penalises deep or loaded parents, using
+         *  the child count a parent may report in the reserved field of its poll response.
+         *
+         *  @param[in]  contactNode The address of the responding node
+         *  @param[in]  goodSignal  The response was received above -64dBm
+         *  @param[in]  load        Number of children reported by the node, 0 if unknown
+         *  @return void
+         */
+        void addContact(const uint16_t contactNode, const bool goodSignal, const uint8_t load);
+
+        /**
+         *  Schedules the next poll sweep, or fails the renewal if its timeout has passed
+         *
+         *  @return void
+         */
+        void retryRenewal();
+
+        /**
+         *  Ends the renewal and notifies the registered callback
+         *
+         *  @param[in]  success     True if an address was assigned
+         *  @return void
+         */
+        void finishRenewal(const bool success);
 
         /**
          *  Waits for data to become available
@@ -231,8 +1797,230 @@ namespace RF24Mesh
          *  @return TODO
          */
         bool waitForAvailable(uint32_t timeout);
+
+        /**
+        *   Looks up a nodeID in the address cache, expiring it if it has outlived MESH_LOOKUP_CACHE_TTL
+        *
+        *   @param[in]  nodeID      The unique identifier (1-255) of the node
+        *   @return The cached address, or -1 if there is no usable entry
+        */
+        int16_t cachedAddress(const uint8_t nodeID);
+
+        /**
+        *   Stores a lookup result, replacing the least recently used entry if the cache is full
+        *
+        *   @param[in]  nodeID      The unique identifier (1-255) of the node
+        *   @param[in]  address     The address the master returned for it
+        *   @return void
+        */
+        void cacheAddress(const uint8_t nodeID, const uint16_t address);
+
+        /**
+        *   Adds or updates an address list entry without persisting it, starting a fresh lease.
+        *   Address 0 stores the node as released, unless MESH_LEASE_PERMANENT maps it to the master.
+        *
+        *   @param[in]  nodeID      The nodeID to assign
+        *   @param[in]  address     The octal RF24Network address to assign
+        *   @param[in]  flags       MESH_LEASE_PERMANENT or 0
+        *   @return False if the address list is full
+        */
+        bool storeAddress(const uint8_t nodeID, const uint16_t address, const uint8_t flags = 0);
+
+        /**
+        *   Drops an entry from the address list, moving the last entry into its place
+        *
+        *   @param[in]  slot        Position in addressList to remove
+        *   @return void
+        */
+        void removeAddress(const uint8_t slot);
+
+        uint32_t localTableSequence; /**< Seqlock sequence of the address table while it isn't mapped */
+        uint32_t *tableSequence;     /**< localTableSequence, or the sequence in the mapped table header */
+        uint8_t tableWriters;        /**< Depth of nested beginTableWrite() calls */
+
+        /**
+        *   Bracket every change to addressList or addrListTop, so snapshotTable() and snapshotDHCP() can
+        *   tell a copy was taken part way through. Calls may nest, the table is published by the outermost.
+        */
+        void beginTableWrite();
+        void endTableWrite();
+
+        /**
+        *   Copies a table guarded by sequence, see snapshotTable()
+        */
+        static uint8_t copyTable(const uint32_t &sequence, const AddressList *const entries, const uint8_t &top, AddressList *const out,
+                                 const uint8_t max, uint32_t *const version);
+
+        /**
+        *   Checks the next MESH_RECLAIM_BATCH entries of the address list. Expired leases are released
+        *   and held for MESH_ADDRESS_HOLD_TIME, and entries whose hold is over are removed.
+        *
+        *   @return void
+        */
+        void reclaimLeases();
+
+        /**
+        *   @param[in]  entry       An address list entry
+        *   @return True if the entry's expiry time is in use: the hold on a released address, or a lease while
+        *   MESH_LEASE_TIME is not 0. Permanent entries, and leases when MESH_LEASE_TIME is 0, never expire.
+        */
+        static bool canExpire(const AddressList &entry);
+
+        /**
+        *   Answers a MESH_ADDR_RENEW with the address the lease was extended for, or -1
+        *
+        *   @param[in]  frame       The renew request
+        *   @return void
+        */
+        void extendLease(const FrameView &frame);
+
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+        /**
+        *   CRC-8 (poly 0x07) of a journal record
+        *
+        *   @param[in]  data        The record
+        *   @param[in]  length      Number of bytes ahead of its crc field
+        *   @return The CRC
+        */
+        static uint8_t journalCRC(const void *const data, const size_t length);
+
+        /**
+        *   @param[in]  nodeID      The node to describe
+        *   @return A record of the node's entry, including its flags and what is left of its lease or hold,
+        *   or a removal if the node has no entry. The sequence number is left to the caller.
+        */
+        JournalRecord journalEntry(const uint8_t nodeID);
+
+        /**
+        *   Appends the current state of a node's address list entry to the DHCP journal
+        *
+        *   @param[in]  nodeID      The node that changed. A node without an entry is journaled as removed.
+        *   @return void
+        */
+        void journalAddress(const uint8_t nodeID);
+
+        /**
+        *   Flushes appended records to storage, at most once every MESH_MIN_SAVE_TIME
+        *
+        *   @return void
+        */
+        void syncJournal();
+
+        /**
+        *   Rewrites the journal if it holds many more records than the table has entries
+        *
+        *   @return True if the journal was rewritten
+        */
+        bool compactJournal();
+
+        /**
+        *   Imports a journal written before MESH_JOURNAL_VERSION 2. Its entries start fresh leases.
+        *
+        *   @param[in]  fd          The open journal
+        *   @return True if any record was replayed, in which case the caller rewrites the journal
+        */
+        bool replayLegacyJournal(const int fd);
+
+        void closeJournal();
+#endif
+
+        /**
+        *   Records an address request so DHCP() can answer it
+        *
+        *   @param[in]  nodeID      The unique identifier (1-255) of the requester
+        *   @param[in]  requester   The node that delivered the request
+        *   @return void
+        */
+        void queueOffer(const uint8_t nodeID, const uint16_t requester, const FrameView &frame);
+
+        /**
+        *   Assigns an offered address once the requester has confirmed it
+        *
+        *   @param[in]  address     The address the confirmation came from
+        *   @return void
+        */
+        void confirmOffer(const uint16_t address);
+
+        /**
+        *   Picks the parent for a request with the allocation policy, then a free child address under it
+        *
+        *   @param[in]  offer       The request
+        *   @return The address to offer, or 0 if none is free
+        */
+        uint16_t allocateAddress(const Offer &offer);
+
+        /**
+        *   Picks a free child address of a parent
+        *
+        *   @param[in]  from_id     The unique identifier (1-255) of the requester
+        *   @param[in]  parent      The parent address, 00 for the master
+        *   @return The address to offer, or 0 if none is free
+        */
+        uint16_t allocateUnder(const uint8_t from_id, const uint16_t parent);
+
+        /**
+        *   Maps an RF24Network address onto a dense index, ordered by level and then by the
+        *   child digits of each level.
+        *
+        *   @param[in]  address     The octal address to convert
+        *   @return The index into addressSlot, or MESH_ADDRESS_INDEX_SIZE if the address is not a valid tree address
+        */
+        static uint16_t addressToIndex(uint16_t address);
+
+        /**
+        *   Counts the octal digits in an address, which is its depth in the tree
+        *
+        *   @param[in]  address     The octal address to measure
+        *   @return The level of the address, 0 for the master
+        */
+        static uint8_t addressLevel(uint16_t address);
+
+        /**
+        *   The parent of an address is the address without its most significant octal digit
+        *
+        *   @param[in]  address     The octal address of a node
+        *   @return The address of its parent, 00 for the master's children
+        */
+        static uint16_t parentOf(const uint16_t address);
+
+        /**
+        *   Finds the addressList entry currently holding an address
+        *
+        *   @param[in]  address     The octal address to search for
+        *   @return Position in addressList, or MESH_INVALID_SLOT if not assigned
+        */
+        uint8_t findAddressSlot(const uint16_t address);
+
+        /**
+        *   Adds or removes the reverse index entry for addressList[slot]
+        *
+        *   @param[in]  slot        Position in addressList that holds the address
+        *   @param[in]  add         True to index the entry, false to drop it from the index
+        *   @return void
+        */
+        void indexAddress(const uint8_t slot, const bool add);
+
+        /**
+        *   Rebuilds both lookup indices from the contents of addressList
+        *
+        *   @return void
+        */
+        void rebuildIndex();
+
+        /**
+        *   @return True if this node acts as the master. Constant unless the role is DynamicRole.
+        */
+        bool isMaster() const
+        {
+            return Role::node ? (Role::master && !nodeID) : true;
+        }
     };
 
+    using Mesh = BasicMesh<DynamicRole>;
+    using MasterMesh = BasicMesh<MasterRole>;
+    using RouterMesh = BasicMesh<RouterRole>;
+    using LeafMesh = BasicMesh<LeafRole>;
+
 } /* !RF24Mesh */
 
 #endif
@@ -9,6 +9,7 @@
 #define RF24MESHDEFINITIONS_HPP
 
 /* C++ Includes */
+#include <cstddef>
 #include <cstdint>
 
 /* NRF24 Networking Driver Includes */
@@ -27,9 +28,46 @@ namespace RF24Mesh
         MESH_ADDR_LOOKUP = 196,
         MESH_ADDR_RELEASE = 197,
         MESH_ID_LOOKUP = 198,
+        MESH_ADDR_LOOKUP_BATCH = 199,
+        MESH_ADDR_SUBSCRIBE = 200,
+        MESH_ADDR_CHANGED = 201,
+        MESH_TABLE_SYNC = 202,
+        MESH_ADDR_RENEW = 203,
+        MESH_SLEEP = 204,
+        MESH_MAIL_DEPOSIT = 205,
+        MESH_MAIL_POLL = 206,
+        MESH_MAIL_DELIVER = 207,
+        MESH_REHOME_HINT = 208,
+        MESH_BULK_DATA = 209,
+        MESH_BULK_ACK = 210,
+        MESH_CHANNEL_SWITCH = 211,
     };
 
     constexpr uint16_t MESH_BLANK_ID = 65535;
+    constexpr uint16_t MESH_INVALID_HANDLE = 0;     /** Returned by Mesh::queueWrite() when nothing was queued */
+
+    /*------------------------------------------------
+    Frame Layout
+    ------------------------------------------------*/
+    constexpr uint8_t MESH_FRAME_PAYLOAD_SIZE = 24;  /** Usable payload of a single RF24Network frame (32 byte frame - 8 byte header) */
+    constexpr uint8_t MESH_MAX_DELTAS = (MESH_FRAME_PAYLOAD_SIZE - 2) / 3; /** Address changes per MESH_ADDR_CHANGED frame (sequence, count, then nodeID + address each) */
+    constexpr uint8_t MESH_SYNC_ENTRIES = (MESH_FRAME_PAYLOAD_SIZE - 4) / 3; /** Table entries per MESH_TABLE_SYNC frame (sequence, start, count, total, then nodeID + address each) */
+    constexpr uint8_t MESH_USER_TYPES = 128;         /** User message types are below this value, see Mesh::setDispatchTable() */
+    constexpr uint8_t MESH_MAX_BATCH_LOOKUP = MESH_FRAME_PAYLOAD_SIZE / sizeof(int16_t); /** NodeIDs resolved per MESH_ADDR_LOOKUP_BATCH exchange */
+    constexpr uint8_t MESH_CONTACT_MARKER = 0xC0;    /** Tags the count byte of the contact list in address requests and renewals, so stale buffer bytes aren't read as one */
+    constexpr uint8_t MESH_MAIL_PAYLOAD_SIZE = MESH_FRAME_PAYLOAD_SIZE - 5; /** Largest message Mesh::writeMail() can send (remaining, sender, type, length, then the data) */
+    constexpr uint8_t MESH_BULK_HEADER = 6;          /** Transfer id, fragment index and total length at the start of every MESH_BULK_DATA frame */
+    constexpr uint8_t MESH_BULK_FRAGMENT = MESH_FRAME_PAYLOAD_SIZE - MESH_BULK_HEADER; /** Data bytes carried per bulk fragment */
+    constexpr uint32_t MESH_BULK_MAX_SIZE = 65535UL * MESH_BULK_FRAGMENT; /** Largest transfer Mesh::sendBulk() can send, limited by the 16 bit fragment index */
+    constexpr uint8_t MESH_BULK_ACK_REQUEST = 0x80;  /** Set in the transfer id of a fragment the receiver should acknowledge straight away */
+
+    /*------------------------------------------------
+    Address Table Indexing
+    ------------------------------------------------*/
+    constexpr uint8_t MESH_INVALID_SLOT = 0xFF;        /** Marks an unused entry in the address table indices */
+    constexpr uint8_t MESH_MAX_LEVELS = 4;             /** Deepest octal level an RF24Network address can have */
+    constexpr uint8_t MESH_MAX_DIGIT = 5;              /** Largest child digit usable at any octal level */
+    constexpr uint16_t MESH_ADDRESS_INDEX_SIZE = 780;  /** Number of distinct addresses in a 4 level tree (5 + 25 + 125 + 625) */
 
     /*------------------------------------------------
     Generic User Config
@@ -42,8 +80,86 @@ namespace RF24Mesh
     ------------------------------------------------*/
     constexpr uint8_t MESH_DEFAULT_CHANNEL = 97;     /** Radio channel to operate on 1-127. This is normally modified by calling mesh.setChannel() */
     constexpr uint16_t MESH_LOOKUP_TIMEOUT = 3000;   /** How long mesh write will retry address lookups before giving up. This is not used when sending to or from the master node. **/
-    constexpr uint16_t MESH_WRITE_TIMEOUT = 5550;    /** UNUSED - How long mesh.write will retry failed payloads. */
+    constexpr uint16_t MESH_WRITE_TIMEOUT = 5550;    /** Default time a queued write may spend retrying before it is reported as timed out */
     constexpr uint16_t MESH_RENEWAL_TIMEOUT = 60000; /** How long to attempt address renewal */
+    constexpr uint8_t MESH_MAX_POLLS = 4;             /** Number of poll responses collected before requesting an address */
+    constexpr uint16_t MESH_POLL_WINDOW = 55;         /** How long to collect poll responses after a multicast poll */
+    constexpr uint16_t MESH_RESPONSE_WINDOW = 225;    /** How long a contact node has to return an address offer */
+    constexpr uint16_t MESH_PROBE_MIN_TIMEOUT = 100;  /** Lower bound on how long a connection probe waits for the master */
+    constexpr uint16_t MESH_PROBE_MAX_TIMEOUT = 2000; /** Upper bound on how long a connection probe waits, also used before the first reply */
+    constexpr uint8_t MESH_PROBE_FAILURES = 3;        /** Consecutive lost probes after which Mesh::shouldRenew() says to renew */
+    constexpr uint8_t MESH_PROBE_MAX_LOSS = 50;       /** Smoothed probe loss in percent above which Mesh::shouldRenew() says to renew */
+    constexpr uint16_t MESH_REATTACH_WINDOW = 225;    /** How long the master has to confirm a previous address before a full renewal starts */
+    constexpr uint8_t MESH_CONFIRM_RETRIES = 6;       /** Attempts at confirming an offered address with the master */
+    constexpr int8_t MESH_RPD_WEIGHT = 8;             /** Score bonus for a poll response received above -64dBm when choosing a parent */
+    constexpr int8_t MESH_LOAD_WEIGHT = 2;            /** Score penalty per child reported in the load hint of a poll response */
+    constexpr int8_t MESH_DEPTH_WEIGHT = 1;           /** Score penalty per octal level of a candidate parent */
+    constexpr uint8_t MESH_MAX_PENDING_OFFERS = 4;    /** Address requests the master can have in flight at once */
+    constexpr uint16_t MESH_OFFER_DELAY = 12;         /** How long the master waits after a request before sending its offer */
+    constexpr int8_t MESH_ALLOC_DEPTH_WEIGHT = 4;     /** Cost per octal level of a parent when the master picks where a node joins */
+    constexpr int8_t MESH_ALLOC_LOAD_WEIGHT = 1;      /** Cost per child a parent already has when the master picks where a node joins */
+    constexpr int8_t MESH_ALLOC_CONTACT_BONUS = 2;    /** Cost taken off the node that relayed a request, whose link is known to work */
+    constexpr int8_t MESH_REHOME_MARGIN = 4;          /** How much cheaper another parent must be before the master suggests a node moves */
+    constexpr int8_t MESH_HINT_WEIGHT = 16;           /** Score bonus for the parent the master suggested, see Mesh::rehomeHint() */
+    constexpr uint8_t MESH_LOOKUP_CACHE_SIZE = 8;     /** Number of nodeID to address lookups a node remembers. Set to 0 to always ask the master. */
+    constexpr uint32_t MESH_LOOKUP_CACHE_TTL = 60000; /** How long a remembered lookup may be used before it is fetched again */
+    constexpr uint8_t MESH_SEND_QUEUE_SIZE = 4;       /** Writes that can be outstanding at once, see Mesh::queueWrite() */
+    constexpr uint8_t MESH_LEAF_SEND_QUEUE_SIZE = 1;  /** As MESH_SEND_QUEUE_SIZE, for a LeafMesh. At least 1. */
+    constexpr uint8_t MESH_LEAF_LOOKUP_CACHE_SIZE = 2; /** As MESH_LOOKUP_CACHE_SIZE, for a LeafMesh, which mostly talks to the master */
+    constexpr uint16_t MESH_SEND_BACKOFF = 50;        /** Delay before the first retry of a queued write, doubled on each further retry */
+    constexpr uint16_t MESH_SEND_MAX_BACKOFF = 800;   /** Upper bound on the retry delay, before up to 50% jitter is added */
+    constexpr uint16_t MESH_ASYNC_LOOKUP_TIMEOUT = 150; /** How long the send queue waits on the reply to an address lookup */
+    constexpr bool MESH_ENABLE_PRIORITY = true;         /** Set false to service the send queue in slot order whatever the message type */
+    constexpr uint8_t MESH_ACKED_TYPES = 65;            /** First user type the network layer acknowledges, see Mesh::write() */
+    constexpr uint8_t MESH_ACKED_BUDGET = 1;            /** Queued writes of acked user types sent per update() while mesh control traffic is outstanding */
+    constexpr bool MESH_LOOKUP_VIA_PARENT = true;       /** Send address lookups to the parent, which answers from its cache or asks further up. Set false to always ask the master. */
+    constexpr uint8_t MESH_PARENT_LOOKUP_MISSES = 2;    /** Unanswered lookups after which a node asks the master directly until it next renews, for parents running older firmware */
+    constexpr uint8_t MESH_MAX_PROXIED_LOOKUPS = 4;     /** Lookups from children a routing node can be waiting on at once */
+    constexpr uint16_t MESH_SUBSCRIBE_REFRESH = 30000;  /** How often a subscribed node repeats its subscription, so a restarted master learns it again */
+    constexpr uint16_t MESH_STANDBY_INTERVAL = 1000;    /** How often a standby master checks that the master is still answering */
+    constexpr uint8_t MESH_STANDBY_MISSES = 3;          /** Unanswered checks after which a standby master takes over as 00 */
+
+    /*------------------------------------------------
+    Sleeping Nodes
+    ------------------------------------------------*/
+    constexpr uint8_t MESH_MAILBOX_SLOTS = 4;         /** Messages a routing node holds for its sleeping children */
+    constexpr uint8_t MESH_MAX_SLEEPERS = MESH_MAX_CHILDREN + 1; /** Sleeping children a routing node keeps track of */
+    constexpr uint32_t MESH_MAILBOX_TTL = 600000;     /** How long a held message waits for its node to wake before it is dropped */
+    constexpr uint16_t MESH_SLEEP_GRACE = 5000;       /** How long past its announced wake time a child is still treated as asleep */
+    constexpr uint8_t MESH_MAIL_INBOX = 4;            /** Delivered messages a node keeps until read with Mesh::readMail() */
+    constexpr uint16_t MESH_WAKE_WINDOW = 20;         /** How long Mesh::wake() waits for the parent to hand over held messages */
+
+    /*------------------------------------------------
+    Bulk Transfers
+    ------------------------------------------------*/
+    constexpr bool MESH_LEAF_BULK = false;           /** Set true to let a LeafMesh send and receive bulk transfers. Without it, transfers to a leaf are refused. */
+    constexpr uint8_t MESH_BULK_WINDOW = 32;          /** Fragments a bulk transfer can have in flight, at most 32 (one bit each in the acknowledgement) */
+    constexpr uint8_t MESH_BULK_BURST = 8;            /** Fragments sent per update() call before the receiver is asked to acknowledge */
+    constexpr uint16_t MESH_BULK_ACK_TIMEOUT = 100;   /** How long the sender waits on an acknowledgement before resending the unacknowledged fragments */
+    constexpr uint16_t MESH_BULK_ACK_DELAY = 20;      /** How long the receiver sits on fragments that didn't ask for an acknowledgement before sending one anyway */
+    constexpr uint32_t MESH_BULK_TIMEOUT = 30000;     /** Default time a bulk transfer may take overall */
+    constexpr uint16_t MESH_BULK_IDLE = 2000;         /** How long a partial incoming transfer blocks one from another sender */
+
+    /*------------------------------------------------
+    Channel Switching
+    ------------------------------------------------*/
+    constexpr uint16_t MESH_SWITCH_DELAY = 2000;      /** Default lead time of Mesh::switchChannel(), long enough for the announcement to reach the deepest level */
+    constexpr uint8_t MESH_SWITCH_REPEATS = 3;        /** Times each routing node announces a channel switch to the level below, since multicasts are not acknowledged */
+    constexpr uint16_t MESH_SWITCH_INTERVAL = 100;    /** Time between repeated announcements of a channel switch */
+
+    /*------------------------------------------------
+    Statistics Config
+    ------------------------------------------------*/
+    constexpr bool MESH_ENABLE_STATS = true;          /** Set false to compile out the Mesh::Stats counters entirely */
+    constexpr uint8_t MESH_LATENCY_BUCKETS = 8;       /** Latency histogram buckets, the last one collects everything slower */
+    constexpr uint16_t MESH_LATENCY_BOUNDS[MESH_LATENCY_BUCKETS - 1] = { 10, 25, 50, 100, 250, 1000, 5000 }; /** Upper bound in ms of each bucket */
+    constexpr uint16_t MESH_SNAPSHOT_RETRIES = 50000; /** Tries a snapshot of the counters or address table makes before reporting the data busy, so a writer that died mid-change can't hang a monitor */
+
+    /*------------------------------------------------
+    Trace Config
+    ------------------------------------------------*/
+    constexpr bool MESH_ENABLE_TRACE = false;         /** Set true to record mesh events in a ring buffer, see Mesh::readTrace(). Unlike the debug prints this doesn't disturb timing. */
+    constexpr uint8_t MESH_TRACE_DEPTH = 64;          /** Events the trace ring holds before the oldest are overwritten, a power of two */
 
     /*------------------------------------------------
     Debug Config
@@ -55,9 +171,40 @@ namespace RF24Mesh
     Misc Config
     ------------------------------------------------*/
     constexpr uint8_t MESH_MAX_ADDRESSES = 255;    /** Determines the max size of the array used for storing addresses on the Master Node */
-    constexpr uint16_t MESH_MIN_SAVE_TIME = 30000; /** Minimum time required before changing nodeID. Prevents excessive writing to EEPROM */
+    constexpr uint8_t MESH_ADDRESS_POOL_SIZE = MESH_MAX_ADDRESSES; /** Number of address entries the master reserves in begin() when no storage was supplied */
+    constexpr bool MESH_STATIC_ADDRESS_POOL = false; /** Set true to reserve the master's address entries statically instead of with a single malloc() in begin(). The pool is shared, so only one mesh per role can use it */
+    constexpr uint16_t MESH_MIN_SAVE_TIME = 30000; /** Minimum time between flushes of saved addresses to storage. Prevents excessive writing to EEPROM/SD cards */
     constexpr uint16_t MESH_DEFAULT_ADDRESS = RF24Network::DEFAULT_ADDRESS;
-    constexpr uint16_t MESH_ADDRESS_HOLD_TIME = 30000; /** How long before a released address becomes available */
+    constexpr uint16_t MESH_ADDRESS_HOLD_TIME = 30000; /** How long before a released or expired address becomes available to another node */
+
+    /*------------------------------------------------
+    Address Leases
+    ------------------------------------------------*/
+    constexpr uint32_t MESH_LEASE_TIME = 3600000;  /** How long the master keeps an address for a node that stops renewing. Set to 0 for addresses that never expire, nodes then never renew and only released addresses are reclaimed. */
+    constexpr uint16_t MESH_LEASE_RETRY = 10000;   /** How often a node repeats an unanswered lease renewal. Nodes first renew halfway through the lease. */
+    constexpr uint8_t MESH_RECLAIM_BATCH = 8;      /** Address list entries the master checks for expiry per call to update() */
+    constexpr uint8_t MESH_LEASE_RELEASED = 0x01;  /** AddressList::flags, the address is held for MESH_ADDRESS_HOLD_TIME and no longer resolves */
+    constexpr uint8_t MESH_LEASE_PERMANENT = 0x02; /** AddressList::flags, the entry was set manually and never expires */
+
+    /*------------------------------------------------
+    Linux Master Persistence
+    ------------------------------------------------*/
+    constexpr char MESH_DHCP_FILE[] = "dhcplist.txt";    /** Address table written by older releases, imported once if no journal exists */
+    constexpr char MESH_DHCP_JOURNAL[] = "dhcplist.jnl"; /** Append-only journal of address assignments and releases */
+    constexpr uint8_t MESH_JOURNAL_SLACK = 64;           /** Extra records tolerated beyond twice the table size before the journal is compacted */
+    constexpr uint8_t MESH_JOURNAL_VERSION = 2;          /** Carried by every journal record. Version 1 records had no lease flags or expiry and are imported once */
+    constexpr bool MESH_DHCP_USE_MMAP = false;           /** Set true to keep the address table in a memory mapped file instead of the journal */
+    constexpr char MESH_DHCP_MAP[] = "dhcplist.map";     /** Memory mapped address table, readable by other processes through Mesh::viewDHCP() */
+    constexpr uint32_t MESH_DHCP_MAP_MAGIC = 0x544D4652; /** "RFMT", identifies a mapped address table */
+    constexpr uint16_t MESH_DHCP_MAP_VERSION = 3;
+
+    /*------------------------------------------------
+    Linux Radio Service (see RF24MeshService.hpp)
+    ------------------------------------------------*/
+    constexpr size_t MESH_SERVICE_RX_DEPTH = 256;      /** Frames buffered for the application, must be a power of two */
+    constexpr size_t MESH_SERVICE_TX_DEPTH = 64;       /** Messages buffered for the radio thread, must be a power of two */
+    constexpr uint32_t MESH_SERVICE_IDLE_US = 500;     /** How long the radio thread sleeps after a pass with nothing to do */
+    constexpr size_t MESH_CACHE_LINE = 64;             /** Keeps the producer and consumer indices of a ring apart */
 }
 
 #endif
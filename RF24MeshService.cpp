@@ -0,0 +1,247 @@
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+
+/* C++ Includes */
+#include <chrono>
+#include <cstring>
+#include <system_error>
+
+/* Linux Includes */
+#include <pthread.h>
+#include <sched.h>
+
+/* Mesh Includes */
+#include "RF24MeshService.hpp"
+
+namespace RF24Mesh
+{
+    MeshService::MeshService(NRF24L::NRF24L01 &radio) : network(radio), meshNode(radio, network), active(false), attachment(ServiceState::STOPPED)
+    {
+        stats.received = 0;
+        stats.rxStalls = 0;
+        stats.sent = 0;
+        stats.sendFailures = 0;
+    }
+
+    MeshService::~MeshService()
+    {
+        stop();
+    }
+
+    bool MeshService::start(const uint8_t nodeID, const int cpu, const uint8_t channel)
+    {
+        if (active.exchange(true))
+        {
+            return false;
+        }
+        attachment = ServiceState::STARTING;
+
+        try
+        {
+            thread = std::thread(&MeshService::run, this, nodeID, cpu, channel);
+        }
+        catch (const std::system_error &)
+        {
+            active = false;
+            attachment = ServiceState::STOPPED;
+            return false;
+        }
+
+        return true;
+    }
+
+    void MeshService::stop()
+    {
+        active = false;
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+        attachment = ServiceState::STOPPED;
+    }
+
+    bool MeshService::running() const
+    {
+        return active.load(std::memory_order_acquire);
+    }
+
+    ServiceState MeshService::state() const
+    {
+        return attachment.load(std::memory_order_acquire);
+    }
+
+    bool MeshService::receive(ServiceFrame &frame)
+    {
+        return rxRing.pop(frame);
+    }
+
+    bool MeshService::send(const void *const data, const uint8_t msg_type, const size_t size, const uint8_t nodeID)
+    {
+        ServiceRequest request;
+        request.destination = nodeID;
+        request.toAddress = false;
+        request.type = msg_type;
+        request.length = static_cast<uint8_t>(size);
+
+        return (size <= MESH_FRAME_PAYLOAD_SIZE) && queueRequest(request, data);
+    }
+
+    bool MeshService::sendTo(const uint16_t address, const void *const data, const uint8_t msg_type, const size_t size)
+    {
+        ServiceRequest request;
+        request.destination = address;
+        request.toAddress = true;
+        request.type = msg_type;
+        request.length = static_cast<uint8_t>(size);
+
+        return (size <= MESH_FRAME_PAYLOAD_SIZE) && queueRequest(request, data);
+    }
+
+    const ServiceCounters &MeshService::counters() const
+    {
+        return stats;
+    }
+
+    Mesh &MeshService::mesh()
+    {
+        return meshNode;
+    }
+
+    bool MeshService::queueRequest(const ServiceRequest &request, const void *const data)
+    {
+        ServiceRequest queued = request;
+        if (data && request.length)
+        {
+            memcpy(queued.payload, data, request.length);
+        }
+        return txRing.push(queued);
+    }
+
+    void MeshService::run(const uint8_t nodeID, const int cpu, const uint8_t channel)
+    {
+        if (cpu >= 0)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+
+        meshNode.setNodeID(nodeID);
+        attachment = meshNode.begin(channel) ? ServiceState::ATTACHED : ServiceState::DETACHED;
+
+        //Writes handed to the mesh send queue, MESH_INVALID_HANDLE where a slot is free
+        SendHandle outstanding[MESH_SEND_QUEUE_SIZE];
+        for (SendHandle &handle : outstanding)
+        {
+            handle = MESH_INVALID_HANDLE;
+        }
+
+        while (active.load(std::memory_order_acquire))
+        {
+            bool busy = (meshNode.update() != 0);
+            meshNode.DHCP();
+
+            /*------------------------------------------------
+            Without an address nothing can be sent, so keep renewing without blocking, which
+            leaves stop() responsive. Received frames are still handed over meanwhile.
+            ------------------------------------------------*/
+            const RenewalState renewal = meshNode.renewalStatus();
+            const bool renewing = (renewal != RenewalState::IDLE) && (renewal != RenewalState::COMPLETE) && (renewal != RenewalState::FAILED);
+            if (meshNode.mesh_address == MESH_DEFAULT_ADDRESS)
+            {
+                attachment = ServiceState::DETACHED;
+                if (!renewing)
+                {
+                    meshNode.beginRenewal();
+                }
+            }
+            else if (!renewing)
+            {
+                attachment = ServiceState::ATTACHED;
+            }
+
+            /*------------------------------------------------
+            Hand received frames to the application. If the ring is full they stay queued
+            in the network layer rather than being dropped here.
+            ------------------------------------------------*/
+            while (network.available())
+            {
+                if (rxRing.full())
+                {
+                    stats.rxStalls++;
+                    break;
+                }
+
+                ServiceFrame frame;
+                frame.length = static_cast<uint8_t>(network.read(frame.header, frame.payload, sizeof(frame.payload)));
+                rxRing.push(frame);
+                stats.received++;
+                busy = true;
+            }
+
+            /*------------------------------------------------
+            Writes by nodeID go through the mesh send queue, which does the address lookups
+            and retries from update() without blocking this thread. A request only leaves
+            the TX ring once the queue has room for it.
+            ------------------------------------------------*/
+            for (SendHandle &handle : outstanding)
+            {
+                if (attachment.load(std::memory_order_relaxed) != ServiceState::ATTACHED)
+                {
+                    break;
+                }
+
+                if (handle != MESH_INVALID_HANDLE)
+                {
+                    const SendStatus status = meshNode.sendStatus(handle);
+                    if (status == SendStatus::PENDING)
+                    {
+                        continue;
+                    }
+
+                    if (status == SendStatus::SENT)
+                    {
+                        stats.sent++;
+                    }
+                    else
+                    {
+                        stats.sendFailures++;
+                    }
+                    handle = MESH_INVALID_HANDLE;
+                }
+
+                ServiceRequest request;
+                while ((handle == MESH_INVALID_HANDLE) && txRing.pop(request))
+                {
+                    busy = true;
+                    if (!request.toAddress)
+                    {
+                        handle = meshNode.queueWrite(request.payload, request.type, request.length, static_cast<uint8_t>(request.destination));
+                        if (handle == MESH_INVALID_HANDLE)
+                        {
+                            stats.sendFailures++;
+                        }
+                        break;
+                    }
+
+                    //A logical address needs no lookup, so it is a single attempt right away
+                    if (meshNode.writeTo(request.destination, request.payload, request.type, request.length))
+                    {
+                        stats.sent++;
+                    }
+                    else
+                    {
+                        stats.sendFailures++;
+                    }
+                }
+            }
+
+            if (!busy)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(MESH_SERVICE_IDLE_US));
+            }
+        }
+    }
+}
+
+#endif /* __linux */
@@ -0,0 +1,243 @@
+/********************************************************************************
+*   RF24MeshService.hpp
+*       Runs a mesh master on a dedicated radio thread (Linux only).
+*
+*   2019 | Brandon Braun | brandonbraun653@gmail.com
+********************************************************************************/
+#pragma once
+#ifndef RF24MESH_SERVICE_HPP
+#define RF24MESH_SERVICE_HPP
+
+#if defined(__linux) && !defined(__ARDUINO_X86__)
+
+/* C++ Headers */
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+/* NRF Library Headers */
+#include "nrf24l01.hpp"
+#include "RF24Network.hpp"
+
+/* Mesh Headers */
+#include "RF24Mesh.hpp"
+#include "RF24MeshDefinitions.hpp"
+
+namespace RF24Mesh
+{
+    /**
+    *   Lock-free ring buffer for exactly one producer thread and one consumer thread.
+    *   Holds at most N - 1 elements.
+    */
+    template<typename T, size_t N>
+    class SPSCRing
+    {
+        static_assert(N && !(N & (N - 1)), "SPSCRing size must be a power of two");
+
+    public:
+        SPSCRing() : head(0), tail(0)
+        {
+        }
+
+        /**
+        *   Producer side
+        *
+        *   @param[in]  item        Copied into the ring
+        *   @return False if the ring is full
+        */
+        bool push(const T &item)
+        {
+            const size_t current = head.load(std::memory_order_relaxed);
+            const size_t next = (current + 1) & (N - 1);
+            if (next == tail.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            slots[current] = item;
+            head.store(next, std::memory_order_release);
+            return true;
+        }
+
+        /**
+        *   Consumer side
+        *
+        *   @param[out] item        Receives the oldest element
+        *   @return False if the ring is empty
+        */
+        bool pop(T &item)
+        {
+            const size_t current = tail.load(std::memory_order_relaxed);
+            if (current == head.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            item = slots[current];
+            tail.store((current + 1) & (N - 1), std::memory_order_release);
+            return true;
+        }
+
+        bool empty() const
+        {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
+
+        bool full() const
+        {
+            return ((head.load(std::memory_order_acquire) + 1) & (N - 1)) == tail.load(std::memory_order_acquire);
+        }
+
+    private:
+        /* Indices on separate cache lines so the two threads don't contend */
+        alignas(MESH_CACHE_LINE) std::atomic<size_t> head;
+        alignas(MESH_CACHE_LINE) std::atomic<size_t> tail;
+        alignas(MESH_CACHE_LINE) T slots[N];
+    };
+
+    /**
+    *   A frame received on the radio thread
+    */
+    struct ServiceFrame
+    {
+        RF24Network::Header header;
+        uint8_t length;
+        uint8_t payload[MESH_FRAME_PAYLOAD_SIZE];
+    };
+
+    /**
+    *   A message queued for the radio thread to send, see MeshService::send()
+    */
+    struct ServiceRequest
+    {
+        uint16_t destination; /**< NodeID, or logical address if `toAddress` is set */
+        bool toAddress;
+        uint8_t type;
+        uint8_t length;
+        uint8_t payload[MESH_FRAME_PAYLOAD_SIZE];
+    };
+
+    /**
+    *   Whether the radio thread has the mesh up, see MeshService::state()
+    */
+    enum class ServiceState : uint8_t
+    {
+        STOPPED,  /**< The radio thread is not running */
+        STARTING, /**< Mesh::begin() is still running */
+        ATTACHED, /**< The node has an address, or is the master */
+        DETACHED  /**< The node has no address and the radio thread keeps renewing it. Sends wait in the TX ring meanwhile. */
+    };
+
+    /**
+    *   Counters kept by the radio thread, readable from any thread
+    */
+    struct ServiceCounters
+    {
+        std::atomic<uint32_t> received;     /**< Frames passed to the RX ring */
+        std::atomic<uint32_t> rxStalls;     /**< Passes where the RX ring was full and frames stayed queued in the network */
+        std::atomic<uint32_t> sent;         /**< TX requests the network layer accepted */
+        std::atomic<uint32_t> sendFailures; /**< TX requests that timed out, had no known destination or found the send queue full */
+    };
+
+    /**
+    *   Runs the mesh, network and radio on their own thread, so slow application work no longer
+    *   lets the radio FIFO overflow. The DHCP and address lookup service are answered on the radio thread.
+    *   Application threads exchange frames with it via two SPSC rings: one thread may call receive()
+    *   and one thread (possibly the same) may call send().
+    *
+    *   @code
+    *   RF24Mesh::MeshService service(radio);
+    *   service.start(0, 3);
+    *   RF24Mesh::ServiceFrame frame;
+    *   while (1)
+    *   {
+    *       while (service.receive(frame)) { ... }
+    *   }
+    *   @endcode
+    */
+    class MeshService
+    {
+    public:
+        /**
+        *   @param[in]  radio       The radio driver. It must not be touched by any other thread while the service runs.
+        */
+        MeshService(NRF24L::NRF24L01 &radio);
+        ~MeshService();
+
+        /**
+        *   Start the radio thread. The mesh is configured and begun from the thread itself, see state() for the outcome.
+        *
+        *   @param[in]  nodeID      The nodeID of this node, 0 for the master
+        *   @param[in]  cpu         Core to pin the radio thread to, -1 to leave it unpinned
+        *   @param[in]  channel     The radio channel (1-127)
+        *   @return False if the service is already running or the thread could not be created
+        */
+        bool start(const uint8_t nodeID = 0, const int cpu = -1, const uint8_t channel = MESH_DEFAULT_CHANNEL);
+
+        /**
+        *   Stop the radio thread and wait for it to exit
+        */
+        void stop();
+
+        bool running() const;
+
+        /**
+        *   @return What the radio thread is doing. A node that fails Mesh::begin() or later loses its
+        *   address is DETACHED until a renewal succeeds, so check this before counting on send().
+        */
+        ServiceState state() const;
+
+        /**
+        *   Take the oldest received frame. Call from a single consumer thread.
+        *
+        *   @param[out] frame       Receives the frame
+        *   @return False if no frame is waiting
+        */
+        bool receive(ServiceFrame &frame);
+
+        /**
+        *   Queue a message for the radio thread to send with Mesh::queueWrite(), which retries it for up to
+        *   MESH_WRITE_TIMEOUT. The outcome is counted in counters() once it is known. Call from a single producer thread.
+        *
+        *   @param[in]  data        The payload
+        *   @param[in]  msg_type    The user message type (1-127)
+        *   @param[in]  size        Payload length, at most MESH_FRAME_PAYLOAD_SIZE
+        *   @param[in]  nodeID      Destination nodeID, the master by default
+        *   @return False if the TX ring is full or the payload is too large
+        */
+        bool send(const void *const data, const uint8_t msg_type, const size_t size, const uint8_t nodeID = 0);
+
+        /**
+        *   As send(), but addressed to a logical address and sent in a single attempt with Mesh::writeTo()
+        */
+        bool sendTo(const uint16_t address, const void *const data, const uint8_t msg_type, const size_t size);
+
+        const ServiceCounters &counters() const;
+
+        /**
+        *   Direct access for configuration (setAddressStorage(), mapDHCP(), setChild() ...) before start().
+        *   Not safe to use while the service is running.
+        */
+        Mesh &mesh();
+
+    private:
+        RF24Network::Network network;
+        Mesh meshNode;
+
+        std::thread thread;
+        std::atomic<bool> active;
+        std::atomic<ServiceState> attachment;
+
+        SPSCRing<ServiceFrame, MESH_SERVICE_RX_DEPTH> rxRing;
+        SPSCRing<ServiceRequest, MESH_SERVICE_TX_DEPTH> txRing;
+        ServiceCounters stats;
+
+        void run(const uint8_t nodeID, const int cpu, const uint8_t channel);
+        bool queueRequest(const ServiceRequest &request, const void *const data);
+    };
+}
+
+#endif /* __linux */
+
+#endif /* RF24MESH_SERVICE_HPP */
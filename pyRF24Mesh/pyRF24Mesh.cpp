@@ -1,105 +1,603 @@
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "boost/python.hpp"
-#include "RF24/RF24.h"
-#include "RF24Network/RF24Network.h"
-#include "RF24Mesh/RF24Mesh.h"
+#include "RF24Mesh/RF24Mesh.hpp"
 
 namespace bp = boost::python;
 
+using RF24Mesh::AddressList;
+using RF24Mesh::LinkQuality;
+using RF24Mesh::Mesh;
+using RF24Mesh::MeshStats;
+using RF24Mesh::RenewalState;
+using RF24Mesh::SendStatus;
+
+
+// ******************** GIL and buffer helpers **************************
+
+/**
+*   Reads or writes the memory of any object supporting the buffer protocol (bytes, bytearray,
+*   memoryview, array, numpy...) in place, and keeps the object locked while it is held.
+*   Must be created and destroyed with the GIL held.
+*/
+class BufferView
+{
+public:
+    explicit BufferView(bp::object buf, const bool writable = false)
+    {
+        if (PyObject_GetBuffer(buf.ptr(), &view, writable ? PyBUF_WRITABLE : PyBUF_SIMPLE) != 0)
+        {
+            bp::throw_error_already_set();
+        }
+    }
+
+    ~BufferView()
+    {
+        PyBuffer_Release(&view);
+    }
+
+    BufferView(const BufferView &) = delete;
+    BufferView &operator=(const BufferView &) = delete;
+
+    void *data() const
+    {
+        return view.buf;
+    }
+
+    size_t size() const
+    {
+        return static_cast<size_t>(view.len);
+    }
+
+private:
+    Py_buffer view;
+};
+
+/**
+*   The mesh as seen from Python. Buffers the mesh keeps pointers to are held here, so they outlive
+*   the transfer, and calls are serialized so update() can run on a background thread.
+*/
+class PyMesh : public Mesh
+{
+public:
+    PyMesh(NRF24L::NRF24L01 &radio, RF24Network::Network &network) : Mesh(radio, network) {}
+
+    std::mutex lock;
+    std::unique_ptr<BufferView> bulkSource; /**< Data of the outgoing transfer, released when the next one starts */
+    std::unique_ptr<BufferView> bulkSink;   /**< Buffer given to setBulkBuffer() */
+};
+
+/**
+*   Lets other Python threads run while the mesh is busy. The GIL is dropped before taking the mesh
+*   lock, so a thread blocked in write() only holds up callers of the same mesh.
+*/
+class MeshCall
+{
+public:
+    explicit MeshCall(PyMesh &mesh) : state(PyEval_SaveThread()), guard(mesh.lock) {}
+
+    ~MeshCall()
+    {
+        guard.unlock();
+        PyEval_RestoreThread(state);
+    }
+
+private:
+    PyThreadState *state;
+    std::unique_lock<std::mutex> guard;
+};
+
+
+/**
+*   Lets other Python threads run during a call that doesn't need the mesh lock
+*/
+class GILRelease
+{
+public:
+    GILRelease() : state(PyEval_SaveThread()) {}
+
+    ~GILRelease()
+    {
+        PyEval_RestoreThread(state);
+    }
+
+private:
+    PyThreadState *state;
+};
+
 
 // ******************** explicit wrappers **************************
 // where needed, especially where buffer is involved
 
-void throw_ba_exception(void)
+// data_rate defaults to None, so importing this module doesn't need the radio module's DataRate converter
+bool begin_wrap(PyMesh &ref, uint8_t channel, bp::object data_rate, uint32_t timeout)
+{
+    const NRF24L::DataRate rate = data_rate.is_none() ? NRF24L::DataRate::DR_1MBPS : bp::extract<NRF24L::DataRate>(data_rate)();
+    MeshCall call(ref);
+    return ref.begin(channel, rate, timeout);
+}
+
+uint8_t update_wrap(PyMesh &ref)
+{
+    MeshCall call(ref);
+    return ref.update();
+}
+
+bool write_wrap(PyMesh &ref, bp::object buf, uint8_t msg_type, uint8_t nodeID)
+{
+    BufferView data(buf);
+    MeshCall call(ref);
+    return ref.write(data.data(), msg_type, data.size(), nodeID);
+}
+
+bool write_to_node_wrap(PyMesh &ref, uint16_t to_node, bp::object buf, uint8_t msg_type)
+{
+    BufferView data(buf);
+    MeshCall call(ref);
+    return ref.writeTo(to_node, data.data(), msg_type, data.size());
+}
+
+// The old write(to_node, data, msg_type, size), which sends the first `size` bytes
+bool write_to_node_size_wrap(PyMesh &ref, uint16_t to_node, bp::object buf, uint8_t msg_type, size_t size)
+{
+    BufferView data(buf);
+    if (size > data.size())
+    {
+        PyErr_SetString(PyExc_ValueError, "size is larger than the buffer");
+        bp::throw_error_already_set();
+    }
+    MeshCall call(ref);
+    return ref.writeTo(to_node, data.data(), msg_type, size);
+}
+
+uint16_t queue_write_wrap(PyMesh &ref, bp::object buf, uint8_t msg_type, uint8_t nodeID, uint32_t timeout)
 {
-    PyErr_SetString(PyExc_TypeError, "buf parameter must be bytes or bytearray");
-    bp::throw_error_already_set();
+    //The queue takes a copy, so the buffer is only needed for the call
+    BufferView data(buf);
+    MeshCall call(ref);
+    return ref.queueWrite(data.data(), msg_type, data.size(), nodeID, timeout);
 }
 
-char *get_bytes_or_bytearray_str(bp::object buf)
+SendStatus send_status_wrap(PyMesh &ref, uint16_t handle)
 {
-    PyObject *py_ba;
-    py_ba = buf.ptr();
-    if (PyByteArray_Check(py_ba))
-        return PyByteArray_AsString(py_ba);
-    else if (PyBytes_Check(py_ba))
-        return PyBytes_AsString(py_ba);
-    else
-        throw_ba_exception();
-    return NULL;
+    MeshCall call(ref);
+    return ref.sendStatus(handle);
 }
 
-int get_bytes_or_bytearray_ln(bp::object buf)
+bool begin_bulk_wrap(PyMesh &ref, uint8_t nodeID, bp::object buf, uint32_t timeout)
 {
-    PyObject *py_ba;
-    py_ba = buf.ptr();
-    if (PyByteArray_Check(py_ba))
-        return PyByteArray_Size(py_ba);
-    else if (PyBytes_Check(py_ba))
-        return PyBytes_Size(py_ba);
-    else
-        throw_ba_exception();
-    return 0;
+    std::unique_ptr<BufferView> data(new BufferView(buf));
+    bool started;
+    {
+        MeshCall call(ref);
+        started = ref.beginBulk(nodeID, data->data(), data->size(), timeout);
+    }
+
+    //Only one transfer is outgoing at a time, so the previous source is no longer in use
+    if (started)
+    {
+        ref.bulkSource = std::move(data);
+    }
+    return started;
 }
 
-bool write_wrap1(RF24Mesh& ref, bp::object buf, uint8_t msg_type)
+bool send_bulk_wrap(PyMesh &ref, uint8_t nodeID, bp::object buf, uint32_t timeout)
 {
-	return ref.write(get_bytes_or_bytearray_str(buf), msg_type, get_bytes_or_bytearray_ln(buf));
+    BufferView data(buf);
+    MeshCall call(ref);
+    return ref.sendBulk(nodeID, data.data(), data.size(), timeout);
 }
 
-bool write_wrap2(RF24Mesh& ref, bp::object buf, uint8_t msg_type, uint8_t nodeID)
+SendStatus bulk_status_wrap(PyMesh &ref)
 {
-	return ref.write(get_bytes_or_bytearray_str(buf), msg_type, get_bytes_or_bytearray_ln(buf), nodeID);
+    MeshCall call(ref);
+    return ref.bulkStatus();
 }
 
-bool write_to_node_wrap(RF24Mesh& ref, uint16_t to_node,  bp::object buf, uint8_t msg_type)
+uint32_t bulk_progress_wrap(PyMesh &ref)
 {
-	return ref.write(to_node, get_bytes_or_bytearray_str(buf), msg_type, get_bytes_or_bytearray_ln(buf));
+    MeshCall call(ref);
+    return ref.bulkProgress();
 }
 
-// ******************** overload wrappers **************************
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(begin_overload, RF24Mesh::begin, 0, 3)
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(getNodeID_overload, RF24Mesh::getNodeID, 0, 1)
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(renewAddress_overload, RF24Mesh::renewAddress, 0, 1)
+void set_bulk_buffer_wrap(PyMesh &ref, bp::object buf)
+{
+    std::unique_ptr<BufferView> sink;
+    if (!buf.is_none())
+    {
+        sink.reset(new BufferView(buf, true));
+    }
+
+    {
+        MeshCall call(ref);
+        ref.setBulkBuffer(sink ? sink->data() : nullptr, sink ? sink->size() : 0);
+    }
+    ref.bulkSink = std::move(sink);
+}
+
+bool bulk_available_wrap(PyMesh &ref)
+{
+    MeshCall call(ref);
+    return ref.bulkAvailable();
+}
+
+// Returns (length, from_node), the data is in the buffer given to setBulkBuffer()
+bp::tuple read_bulk_wrap(PyMesh &ref)
+{
+    uint16_t from = 0;
+    size_t length;
+    {
+        MeshCall call(ref);
+        length = ref.readBulk(from);
+    }
+    return bp::make_tuple(length, from);
+}
+
+void set_node_id_wrap(PyMesh &ref, uint8_t nodeID)
+{
+    MeshCall call(ref);
+    ref.setNodeID(nodeID);
+}
+
+void dhcp_wrap(PyMesh &ref)
+{
+    MeshCall call(ref);
+    ref.DHCP();
+}
+
+int16_t get_node_id_wrap(PyMesh &ref, uint16_t address)
+{
+    MeshCall call(ref);
+    return ref.getNodeID(address);
+}
+
+bool check_connection_wrap(PyMesh &ref)
+{
+    MeshCall call(ref);
+    return ref.checkConnection();
+}
+
+bool probe_connection_wrap(PyMesh &ref)
+{
+    MeshCall call(ref);
+    return ref.probeConnection();
+}
+
+uint16_t renew_address_wrap(PyMesh &ref, uint32_t timeout)
+{
+    MeshCall call(ref);
+    return ref.renewAddress(timeout);
+}
+
+bool begin_renewal_wrap(PyMesh &ref, uint32_t timeout)
+{
+    MeshCall call(ref);
+    return ref.beginRenewal(timeout);
+}
+
+RenewalState renewal_status_wrap(PyMesh &ref)
+{
+    MeshCall call(ref);
+    return ref.renewalStatus();
+}
+
+bool release_address_wrap(PyMesh &ref)
+{
+    MeshCall call(ref);
+    return ref.releaseAddress();
+}
+
+int16_t get_address_wrap(PyMesh &ref, uint8_t nodeID)
+{
+    MeshCall call(ref);
+    return ref.getAddress(nodeID);
+}
+
+// Takes any sequence of nodeIDs and returns a list of addresses, negative where not found
+bp::list get_addresses_wrap(PyMesh &ref, bp::object nodeIDs)
+{
+    std::vector<uint8_t> ids;
+    const size_t n = bp::len(nodeIDs);
+    for (size_t i = 0; i < n; i++)
+    {
+        ids.push_back(bp::extract<uint8_t>(nodeIDs[i]));
+    }
+
+    std::vector<int16_t> out(n);
+    {
+        MeshCall call(ref);
+        ref.getAddresses(ids.data(), n, out.data());
+    }
+
+    bp::list addresses;
+    for (const int16_t address : out)
+    {
+        addresses.append(address);
+    }
+    return addresses;
+}
+
+void set_channel_wrap(PyMesh &ref, uint8_t channel)
+{
+    MeshCall call(ref);
+    ref.setChannel(channel);
+}
+
+bool switch_channel_wrap(PyMesh &ref, uint8_t channel, uint16_t delay)
+{
+    MeshCall call(ref);
+    return ref.switchChannel(channel, delay);
+}
+
+uint8_t pending_channel_wrap(PyMesh &ref)
+{
+    MeshCall call(ref);
+    return ref.pendingChannel();
+}
+
+void set_child_wrap(PyMesh &ref, bool allow)
+{
+    MeshCall call(ref);
+    ref.setChild(allow);
+}
+
+void set_address_wrap(PyMesh &ref, uint8_t nodeID, uint16_t address, bool permanent)
+{
+    MeshCall call(ref);
+    ref.setAddress(nodeID, address, permanent);
+}
+
+// The old name for a user assigned address, which is now a permanent one
+void set_static_address_wrap(PyMesh &ref, uint8_t nodeID, uint16_t address)
+{
+    set_address_wrap(ref, nodeID, address, true);
+}
+
+void save_dhcp_wrap(PyMesh &ref)
+{
+    MeshCall call(ref);
+    ref.saveDHCP();
+}
+
+void load_dhcp_wrap(PyMesh &ref)
+{
+    MeshCall call(ref);
+    ref.loadDHCP();
+}
+
+uint16_t mesh_address_wrap(PyMesh &ref)
+{
+    MeshCall call(ref);
+    return ref.mesh_address;
+}
+
+// ******************** monitoring **************************
+// getStats(), snapshotTable() and tableVersion() are safe alongside update(), so they skip the mesh lock
+// and can watch a mesh whose lock is held by a blocking call on another thread
+
+bp::list histogram_list(const RF24Mesh::LatencyHistogram &histogram)
+{
+    bp::list buckets;
+    for (const uint32_t count : histogram.buckets)
+    {
+        buckets.append(count);
+    }
+    return buckets;
+}
+
+// Returns the counters as a dict, with the version under "version" and the histograms as lists
+bp::dict get_stats_wrap(PyMesh &ref)
+{
+    MeshStats stats = MeshStats();
+    uint32_t version;
+    {
+        //Bounded by MESH_SNAPSHOT_RETRIES, so worth letting other threads run meanwhile
+        GILRelease call;
+        version = ref.getStats(stats);
+    }
+
+    bp::dict out;
+    out["version"] = version;
+    out["lookupsServed"] = stats.lookupsServed;
+    out["lookupsSent"] = stats.lookupsSent;
+    out["lookupFailures"] = stats.lookupFailures;
+    out["lookupCacheHits"] = stats.lookupCacheHits;
+    out["dhcpRequests"] = stats.dhcpRequests;
+    out["dhcpOffers"] = stats.dhcpOffers;
+    out["dhcpConfirms"] = stats.dhcpConfirms;
+    out["dhcpTimeouts"] = stats.dhcpTimeouts;
+    out["renewals"] = stats.renewals;
+    out["renewalFailures"] = stats.renewalFailures;
+    out["reattaches"] = stats.reattaches;
+    out["connectionChecks"] = stats.connectionChecks;
+    out["connectionFailures"] = stats.connectionFailures;
+    out["writes"] = stats.writes;
+    out["writeFailures"] = stats.writeFailures;
+    out["bulkFragments"] = stats.bulkFragments;
+    out["bulkResends"] = stats.bulkResends;
+    out["lookupLatency"] = histogram_list(stats.lookupLatency);
+    out["renewalLatency"] = histogram_list(stats.renewalLatency);
+    return out;
+}
+
+void reset_stats_wrap(PyMesh &ref)
+{
+    MeshCall call(ref);
+    ref.resetStats();
+}
+
+// Returns (entries, version), see Mesh::snapshotTable()
+bp::tuple snapshot_table_wrap(PyMesh &ref)
+{
+    std::vector<AddressList> table(RF24Mesh::MESH_MAX_ADDRESSES);
+    uint32_t version = 0;
+    uint8_t count;
+    {
+        GILRelease call;
+        count = ref.snapshotTable(table.data(), RF24Mesh::MESH_MAX_ADDRESSES, &version);
+    }
+
+    bp::list entries;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        entries.append(table[i]);
+    }
+    return bp::make_tuple(entries, version);
+}
+
+uint32_t table_version_wrap(PyMesh &ref)
+{
+    return ref.tableVersion();
+}
+
+LinkQuality get_link_quality_wrap(PyMesh &ref)
+{
+    LinkQuality quality;
+    MeshCall call(ref);
+    ref.getLinkQuality(quality);
+    return quality;
+}
+
+bool probe_pending_wrap(PyMesh &ref)
+{
+    MeshCall call(ref);
+    return ref.probePending();
+}
+
+bool should_renew_wrap(PyMesh &ref)
+{
+    MeshCall call(ref);
+    return ref.shouldRenew();
+}
 
 // ******************** RF24Mesh exposed  **************************
 BOOST_PYTHON_MODULE(RF24Mesh)
 {
-    { //::RF24Mesh
-        bp::class_<RF24Mesh>("RF24Mesh", bp::init<RF24&, RF24Network&>((bp::arg("_radio"), bp::arg("_network"))))
-            //bool begin(uint8_t channel = MESH_DEFAULT_CHANNEL, rf24_datarate_e data_rate = RF24_1MBPS, uint32_t timeout=MESH_RENEWAL_TIMEOUT );
-            .def("begin", &RF24Mesh::begin, begin_overload(bp::args("channel", "data_rate", "timeout")))
+    bp::enum_<SendStatus>("SendStatus")
+        .value("UNKNOWN", SendStatus::UNKNOWN)
+        .value("PENDING", SendStatus::PENDING)
+        .value("SENT", SendStatus::SENT)
+        .value("TIMEOUT", SendStatus::TIMEOUT)
+        .value("UNKNOWN_NODE", SendStatus::UNKNOWN_NODE)
+        .value("REFUSED", SendStatus::REFUSED);
+
+    bp::enum_<RenewalState>("RenewalState")
+        .value("IDLE", RenewalState::IDLE)
+        .value("REATTACH", RenewalState::REATTACH)
+        .value("BACKOFF", RenewalState::BACKOFF)
+        .value("POLL", RenewalState::POLL)
+        .value("REQUEST", RenewalState::REQUEST)
+        .value("CONFIRM", RenewalState::CONFIRM)
+        .value("COMPLETE", RenewalState::COMPLETE)
+        .value("FAILED", RenewalState::FAILED);
+
+    bp::scope().attr("MESH_INVALID_HANDLE") = RF24Mesh::MESH_INVALID_HANDLE;
+    bp::scope().attr("MESH_LEASE_RELEASED") = RF24Mesh::MESH_LEASE_RELEASED;
+    bp::scope().attr("MESH_LEASE_PERMANENT") = RF24Mesh::MESH_LEASE_PERMANENT;
+
+    bp::class_<AddressList>("AddressList")
+        .def_readonly("nodeID", &AddressList::nodeID)
+        .def_readonly("flags", &AddressList::flags)
+        .def_readonly("address", &AddressList::address)
+        .def_readonly("expires", &AddressList::expires);
+
+    bp::class_<LinkQuality>("LinkQuality")
+        .def_readonly("srtt", &LinkQuality::srtt)
+        .def_readonly("rttvar", &LinkQuality::rttvar)
+        .def_readonly("timeout", &LinkQuality::timeout)
+        .def_readonly("loss", &LinkQuality::loss)
+        .def_readonly("consecutiveLosses", &LinkQuality::consecutiveLosses)
+        .def_readonly("samples", &LinkQuality::samples)
+        .def_readonly("addressLost", &LinkQuality::addressLost);
+
+    { //::RF24Mesh::Mesh
+        // The mesh keeps references to the radio and network, so they must live as long as it does
+        bp::class_<PyMesh, boost::noncopyable>("RF24Mesh", bp::init<NRF24L::NRF24L01 &, RF24Network::Network &>(
+                                                              (bp::arg("_radio"), bp::arg("_network")))[bp::with_custodian_and_ward<1, 2, bp::with_custodian_and_ward<1, 3>>()])
+            //bool begin(uint8_t channel = MESH_DEFAULT_CHANNEL, DataRate data_rate = DR_1MBPS, uint32_t timeout = MESH_RENEWAL_TIMEOUT);
+            .def("begin", &begin_wrap, (bp::arg("self"), bp::arg("channel") = RF24Mesh::MESH_DEFAULT_CHANNEL, bp::arg("data_rate") = bp::object(),
+                                        bp::arg("timeout") = RF24Mesh::MESH_RENEWAL_TIMEOUT))
             //uint8_t update();
-            .def("update", &RF24Mesh::update)
-            //bool write(const void* data, uint8_t msg_type, size_t size, uint8_t nodeID=0);
-            .def("write", &write_wrap1, (bp::arg("data"), bp::arg("msg_type")))
-            .def("write", &write_wrap2, (bp::arg("data"), bp::arg("msg_type"), bp::arg("nodeID")))
-            //bool write(uint16_t to_node, const void* data, uint8_t msg_type, size_t size );
-            .def("write", &write_to_node_wrap, (bp::arg("to_node"), bp::arg("data"), bp::arg("msg_type"), bp::arg("size")))
+            .def("update", &update_wrap)
+            //bool write(const void *data, uint8_t msg_type, size_t size, uint8_t nodeID = 0);
+            .def("write", &write_wrap, (bp::arg("self"), bp::arg("data"), bp::arg("msg_type"), bp::arg("nodeID") = 0))
+            //bool write(uint16_t to_node, const void *data, uint8_t msg_type, size_t size);
+            .def("write", &write_to_node_size_wrap, (bp::arg("self"), bp::arg("to_node"), bp::arg("data"), bp::arg("msg_type"), bp::arg("size")))
+            //bool writeTo(uint16_t node, const void *data, uint8_t msg_type, size_t size);
+            .def("writeTo", &write_to_node_wrap, (bp::arg("self"), bp::arg("to_node"), bp::arg("data"), bp::arg("msg_type")))
+            //SendHandle queueWrite(const void *data, uint8_t msg_type, size_t size, uint8_t nodeID = 0, uint32_t timeout = MESH_WRITE_TIMEOUT);
+            .def("queueWrite", &queue_write_wrap, (bp::arg("self"), bp::arg("data"), bp::arg("msg_type"), bp::arg("nodeID") = 0,
+                                                   bp::arg("timeout") = RF24Mesh::MESH_WRITE_TIMEOUT))
+            //SendStatus sendStatus(SendHandle handle) const;
+            .def("sendStatus", &send_status_wrap, (bp::arg("self"), bp::arg("handle")))
+            //bool beginBulk(uint8_t nodeID, const void *data, size_t size, uint32_t timeout = MESH_BULK_TIMEOUT);
+            .def("beginBulk", &begin_bulk_wrap, (bp::arg("self"), bp::arg("nodeID"), bp::arg("data"), bp::arg("timeout") = RF24Mesh::MESH_BULK_TIMEOUT))
+            //bool sendBulk(uint8_t nodeID, const void *data, size_t size, uint32_t timeout = MESH_BULK_TIMEOUT);
+            .def("sendBulk", &send_bulk_wrap, (bp::arg("self"), bp::arg("nodeID"), bp::arg("data"), bp::arg("timeout") = RF24Mesh::MESH_BULK_TIMEOUT))
+            //SendStatus bulkStatus() const;
+            .def("bulkStatus", &bulk_status_wrap)
+            //uint32_t bulkProgress() const;
+            .def("bulkProgress", &bulk_progress_wrap)
+            //void setBulkBuffer(void *buffer, size_t capacity);
+            .def("setBulkBuffer", &set_bulk_buffer_wrap, (bp::arg("self"), bp::arg("buffer")))
+            //bool bulkAvailable() const;
+            .def("bulkAvailable", &bulk_available_wrap)
+            //size_t readBulk(uint16_t &from);
+            .def("readBulk", &read_bulk_wrap)
             //void setNodeID(uint8_t nodeID);
-            .def("setNodeID", &RF24Mesh::setNodeID, (bp::arg("nodeID")))
+            .def("setNodeID", &set_node_id_wrap, (bp::arg("self"), bp::arg("nodeID")))
             //void DHCP();
-            .def("DHCP", &RF24Mesh::DHCP)
-            //int16_t getNodeID(uint16_t address=MESH_BLANK_ID);
-            .def("getNodeID", &RF24Mesh::getNodeID, getNodeID_overload(bp::args("address")))
+            .def("DHCP", &dhcp_wrap)
+            //int16_t getNodeID(uint16_t address = MESH_BLANK_ID);
+            .def("getNodeID", &get_node_id_wrap, (bp::arg("self"), bp::arg("address") = RF24Mesh::MESH_BLANK_ID))
             //bool checkConnection();
-            .def("checkConnection", &RF24Mesh::checkConnection)
-            //uint16_t renewAddress(uint32_t timeout=MESH_RENEWAL_TIMEOUT);
-            .def("renewAddress", &RF24Mesh::renewAddress, getNodeID_overload(bp::args("timeout")))
+            .def("checkConnection", &check_connection_wrap)
+            //bool probeConnection();
+            .def("probeConnection", &probe_connection_wrap)
+            //bool probePending() const;
+            .def("probePending", &probe_pending_wrap)
+            //void getLinkQuality(LinkQuality &quality) const;
+            .def("getLinkQuality", &get_link_quality_wrap)
+            //bool shouldRenew() const;
+            .def("shouldRenew", &should_renew_wrap)
+            //uint16_t renewAddress(uint32_t timeout = MESH_RENEWAL_TIMEOUT);
+            .def("renewAddress", &renew_address_wrap, (bp::arg("self"), bp::arg("timeout") = RF24Mesh::MESH_RENEWAL_TIMEOUT))
+            //bool beginRenewal(uint32_t timeout = MESH_RENEWAL_TIMEOUT);
+            .def("beginRenewal", &begin_renewal_wrap, (bp::arg("self"), bp::arg("timeout") = RF24Mesh::MESH_RENEWAL_TIMEOUT))
+            //RenewalState renewalStatus() const;
+            .def("renewalStatus", &renewal_status_wrap)
             //bool releaseAddress();
-            .def("releaseAddress", &RF24Mesh::releaseAddress)
+            .def("releaseAddress", &release_address_wrap)
             //int16_t getAddress(uint8_t nodeID);
-            .def("getAddress", &RF24Mesh::getAddress, (bp::arg("nodeID")))
-            //void setChannel(uint8_t _channel);
-            .def("setChannel", &RF24Mesh::setChannel, (bp::arg("_channel")))
+            .def("getAddress", &get_address_wrap, (bp::arg("self"), bp::arg("nodeID")))
+            //size_t getAddresses(const uint8_t *ids, size_t n, int16_t *out);
+            .def("getAddresses", &get_addresses_wrap, (bp::arg("self"), bp::arg("nodeIDs")))
+            //void setChannel(uint8_t channel);
+            .def("setChannel", &set_channel_wrap, (bp::arg("self"), bp::arg("_channel")))
+            //bool switchChannel(uint8_t channel, uint16_t delay = MESH_SWITCH_DELAY);
+            .def("switchChannel", &switch_channel_wrap, (bp::arg("self"), bp::arg("channel"), bp::arg("delay") = RF24Mesh::MESH_SWITCH_DELAY))
+            //uint8_t pendingChannel() const;
+            .def("pendingChannel", &pending_channel_wrap)
             //void setChild(bool allow);
-            .def("setChild", &RF24Mesh::setChild, (bp::arg("allow")))
-            //void setAddress(uint8_t nodeID, uint16_t address);
-            .def("setAddress", &RF24Mesh::setAddress, (bp::arg("nodeID"), bp::arg("address")))
+            .def("setChild", &set_child_wrap, (bp::arg("self"), bp::arg("allow")))
+            //void setAddress(uint8_t nodeID, uint16_t address, bool permanent = false);
+            .def("setAddress", &set_address_wrap, (bp::arg("self"), bp::arg("nodeID"), bp::arg("address"), bp::arg("permanent") = false))
+            //void setStaticAddress(uint8_t nodeID, uint16_t address);
+            .def("setStaticAddress", &set_static_address_wrap, (bp::arg("self"), bp::arg("nodeID"), bp::arg("address")))
             //void saveDHCP();
-            .def("saveDHCP", &RF24Mesh::saveDHCP)
+            .def("saveDHCP", &save_dhcp_wrap)
             //void loadDHCP();
-            .def("loadDHCP", &RF24Mesh::loadDHCP)
-            //void setStaticAddress(uint8_t nodeID, uint16_t address);
-            .def("setStaticAddress", &RF24Mesh::setStaticAddress, (bp::arg("nodeID"), bp::arg("address")));
+            .def("loadDHCP", &load_dhcp_wrap)
+            //uint32_t getStats(Stats &out) const;
+            .def("getStats", &get_stats_wrap)
+            //void resetStats();
+            .def("resetStats", &reset_stats_wrap)
+            //uint8_t snapshotTable(AddressList *out, uint8_t max, uint32_t *version = nullptr) const;
+            .def("snapshotTable", &snapshot_table_wrap)
+            //uint32_t tableVersion() const;
+            .def("tableVersion", &table_version_wrap)
+            //uint16_t mesh_address;
+            .add_property("mesh_address", &mesh_address_wrap);
     }
-}
\ No newline at end of file
+}
@@ -1,15 +1,24 @@
 #!/usr/bin/env python
 
-from distutils.core import setup, Extension
+try:
+    from setuptools import setup, Extension
+except ImportError:
+    from distutils.core import setup, Extension
+from ctypes.util import find_library
 import sys
 
-if sys.version_info >= (3,): 
-    BOOST_LIB = 'boost_python3' 
-else: 
-    BOOST_LIB = 'boost_python' 
+# Distributions name the library after the exact Python version, e.g. boost_python311
+BOOST_LIB = 'boost_python{}{}'.format(*sys.version_info[:2])
+if not find_library(BOOST_LIB):
+    if sys.version_info >= (3,):
+        BOOST_LIB = 'boost_python3'
+    else:
+        BOOST_LIB = 'boost_python'
 
+# Build and install the C++ library first (make install in the parent directory)
 module_RF24Mesh = Extension('RF24Mesh',
             libraries = ['rf24mesh', 'rf24network', BOOST_LIB],
+            extra_compile_args = ['-std=c++14'],
             sources = ['pyRF24Mesh.cpp'])
 
 setup(name='RF24Mesh',
@@ -0,0 +1,334 @@
+/********************************************************************************
+*   MeshBenchmark.cpp
+*       Joins a master and N virtual nodes on the simulated medium, each on its
+*       own thread, and reports join time, DHCP throughput, lookup latency and
+*       how quickly the mesh converges after every node renews at once.
+*
+*   2019 | Brandon Braun | brandonbraun653@gmail.com
+********************************************************************************/
+
+/* C++ Includes */
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/* Linux Includes */
+#include <getopt.h>
+#include <unistd.h>
+
+/* Mesh Includes */
+#include "Chimera/chimera.hpp"
+#include "RF24Mesh.hpp"
+#include "SimMedium.hpp"
+
+using namespace RF24Mesh;
+
+namespace
+{
+    enum class Phase : uint8_t
+    {
+        JOIN,
+        LOOKUP,
+        RENEW,
+        STOP
+    };
+
+    struct Options
+    {
+        uint8_t nodes;
+        uint16_t lookups;       /**< Lookups made by each node */
+        uint32_t timeout;       /**< How long a join or renewal may take */
+        uint16_t stagger;       /**< Delay between successive nodes starting to join */
+        RF24Sim::MediumConfig medium;
+    };
+
+    struct VirtualNode
+    {
+        NRF24L::NRF24L01 radio;
+        RF24Network::Network network;
+        RouterMesh mesh;
+
+        uint8_t nodeID;
+        bool joined;
+        uint32_t joinUs;
+        std::vector<uint32_t> lookupUs;
+        uint16_t lookupFailures;
+        bool renewed;
+        uint32_t renewUs;
+
+        VirtualNode(const uint8_t id) : network(radio), mesh(radio, network), nodeID(id), joined(false), joinUs(0), lookupFailures(0), renewed(false), renewUs(0)
+        {
+        }
+    };
+
+    std::atomic<Phase> phase(Phase::JOIN);
+    std::atomic<uint16_t> finished(0);  /**< Nodes that completed the current phase */
+
+    void runMaster(MasterMesh &master)
+    {
+        while (phase.load() != Phase::STOP)
+        {
+            master.update();
+            master.DHCP();
+        }
+    }
+
+    void lookupPeers(VirtualNode &node, const Options &options)
+    {
+        uint32_t state = 0x9E3779B9u ^ node.nodeID;
+        for (uint16_t i = 0; i < options.lookups; i++)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            const uint8_t target = 1 + (state % options.nodes);
+
+            const uint32_t start = Chimera::micros();
+            if (node.mesh.getAddress(target) >= 0)
+            {
+                node.lookupUs.push_back(Chimera::micros() - start);
+            }
+            else
+            {
+                node.lookupFailures++;
+            }
+
+            //Let the node route for others between its own lookups
+            for (uint8_t n = 0; n < 10; n++)
+            {
+                node.mesh.update();
+            }
+        }
+    }
+
+    void runNode(VirtualNode &node, const Options &options)
+    {
+        node.mesh.setNodeID(node.nodeID);
+        Chimera::delayMilliseconds(options.stagger * (node.nodeID - 1));
+
+        const uint32_t start = Chimera::micros();
+        node.joined = node.mesh.begin(MESH_DEFAULT_CHANNEL, NRF24L::DataRate::DR_1MBPS, options.timeout);
+        node.joinUs = Chimera::micros() - start;
+        finished++;
+
+        Phase seen = Phase::JOIN;
+        while (seen != Phase::STOP)
+        {
+            const Phase current = phase.load();
+            if (current != seen)
+            {
+                seen = current;
+                if ((seen == Phase::LOOKUP) && node.joined)
+                {
+                    lookupPeers(node, options);
+                }
+                else if (seen == Phase::RENEW)
+                {
+                    const uint32_t renewStart = Chimera::micros();
+                    node.renewed = node.mesh.renewAddress(options.timeout) != 0;
+                    node.renewUs = Chimera::micros() - renewStart;
+                }
+                finished++;
+            }
+            node.mesh.update();
+        }
+    }
+
+    /**
+    *   Starts a phase and waits for every node to finish it
+    *
+    *   @return How long the phase took in microseconds
+    */
+    uint32_t runPhase(const Phase next, const uint8_t nodes)
+    {
+        const uint32_t start = Chimera::micros();
+        finished = 0;
+        phase = next;
+        while (finished.load() < nodes)
+        {
+            Chimera::delayMilliseconds(1);
+        }
+        return Chimera::micros() - start;
+    }
+
+    uint32_t percentile(std::vector<uint32_t> samples, const uint8_t percent)
+    {
+        if (samples.empty())
+        {
+            return 0;
+        }
+        std::sort(samples.begin(), samples.end());
+        return samples[(percent * (samples.size() - 1)) / 100];
+    }
+
+    void printTimes(const char *const name, const std::vector<uint32_t> &samples)
+    {
+        printf("%-10s p50 %8.2f ms   p90 %8.2f ms   p99 %8.2f ms   max %8.2f ms\n", name,
+               percentile(samples, 50) / 1000.0, percentile(samples, 90) / 1000.0,
+               percentile(samples, 99) / 1000.0, percentile(samples, 100) / 1000.0);
+    }
+
+    void usage(const char *const program)
+    {
+        printf("Usage: %s [-n nodes] [-k lookups] [-l loss%%] [-p hop latency us] [-a airtime us] [-g stagger ms] [-t timeout ms] [-s seed]\n", program);
+    }
+
+    bool parseOptions(int argc, char **argv, Options &options)
+    {
+        options.nodes = 16;
+        options.lookups = 20;
+        options.timeout = 60000;
+        options.stagger = 0;
+        options.medium = RF24Sim::DEFAULT_MEDIUM;
+
+        int option;
+        while ((option = getopt(argc, argv, "n:k:l:p:a:g:t:s:")) != -1)
+        {
+            const long value = strtol(optarg, nullptr, 0);
+            switch (option)
+            {
+                case 'n':
+                    options.nodes = static_cast<uint8_t>(std::min(std::max(value, 1L), 254L));
+                    break;
+                case 'k':
+                    options.lookups = static_cast<uint16_t>(value);
+                    break;
+                case 'l':
+                    options.medium.lossPercent = static_cast<uint8_t>(std::min(value, 100L));
+                    break;
+                case 'p':
+                    options.medium.hopLatencyUs = static_cast<uint16_t>(value);
+                    break;
+                case 'a':
+                    options.medium.airtimeUs = static_cast<uint16_t>(value);
+                    break;
+                case 'g':
+                    options.stagger = static_cast<uint16_t>(value);
+                    break;
+                case 't':
+                    options.timeout = static_cast<uint32_t>(value);
+                    break;
+                case 's':
+                    options.medium.seed = static_cast<uint32_t>(value);
+                    break;
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    RF24Sim::Medium::instance().configure(options.medium);
+
+    //The master keeps its address table on disk, so run somewhere that doesn't touch a real one
+    char scratch[] = "/tmp/meshbench.XXXXXX";
+    if (!mkdtemp(scratch) || (chdir(scratch) != 0))
+    {
+        perror("scratch directory");
+        return 2;
+    }
+
+    printf("RF24Mesh benchmark: %u nodes, %u%% loss per hop, %uus airtime, %uus hop latency\n",
+           options.nodes, options.medium.lossPercent, options.medium.airtimeUs, options.medium.hopLatencyUs);
+
+    NRF24L::NRF24L01 masterRadio;
+    RF24Network::Network masterNetwork(masterRadio);
+    MasterMesh master(masterRadio, masterNetwork);
+    master.begin();
+
+    std::vector<std::unique_ptr<VirtualNode>> nodes;
+    for (uint8_t i = 0; i < options.nodes; i++)
+    {
+        nodes.emplace_back(new VirtualNode(i + 1));
+    }
+
+    std::thread masterThread(runMaster, std::ref(master));
+    std::vector<std::thread> threads;
+    const uint32_t joinStart = Chimera::micros();
+    for (auto &node : nodes)
+    {
+        threads.emplace_back(runNode, std::ref(*node), std::cref(options));
+    }
+
+    while (finished.load() < options.nodes)
+    {
+        Chimera::delayMilliseconds(1);
+    }
+    const uint32_t joinUs = Chimera::micros() - joinStart;
+
+    std::vector<uint32_t> joinTimes;
+    for (const auto &node : nodes)
+    {
+        if (node->joined)
+        {
+            joinTimes.push_back(node->joinUs);
+        }
+    }
+
+    const size_t joined = joinTimes.size();
+    printf("join       %zu/%u nodes joined in %.1f ms\n", joined, options.nodes, joinUs / 1000.0);
+    printTimes("", joinTimes);
+    printf("dhcp       %.2f addresses/s\n", joined * 1e6 / joinUs);
+
+    runPhase(Phase::LOOKUP, options.nodes);
+    std::vector<uint32_t> lookupTimes;
+    uint32_t lookupFailures = 0;
+    for (const auto &node : nodes)
+    {
+        lookupTimes.insert(lookupTimes.end(), node->lookupUs.begin(), node->lookupUs.end());
+        lookupFailures += node->lookupFailures;
+    }
+    printf("lookup     %zu answered, %u failed\n", lookupTimes.size(), lookupFailures);
+    printTimes("", lookupTimes);
+
+    const uint32_t renewUs = runPhase(Phase::RENEW, options.nodes);
+    std::vector<uint32_t> renewTimes;
+    for (const auto &node : nodes)
+    {
+        if (node->renewed)
+        {
+            renewTimes.push_back(node->renewUs);
+        }
+    }
+    printf("renewal    %zu/%u nodes renewed at once, converged in %.1f ms\n", renewTimes.size(), options.nodes, renewUs / 1000.0);
+    printTimes("", renewTimes);
+
+    phase = Phase::STOP;
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    masterThread.join();
+
+    MeshStats stats;
+    master.getStats(stats);
+    const RF24Sim::MediumCounters medium = RF24Sim::Medium::instance().counters();
+    printf("master     %u requests, %u offers, %u confirms, %u offer timeouts, %u lookups served\n",
+           stats.dhcpRequests, stats.dhcpOffers, stats.dhcpConfirms, stats.dhcpTimeouts, stats.lookupsServed);
+    printf("medium     %llu frames, %llu delivered, %llu lost, %llu unroutable\n",
+           static_cast<unsigned long long>(medium.transmissions), static_cast<unsigned long long>(medium.delivered),
+           static_cast<unsigned long long>(medium.lost), static_cast<unsigned long long>(medium.unroutable));
+
+    unlink(MESH_DHCP_JOURNAL);
+    unlink(MESH_DHCP_MAP);
+    unlink(MESH_DHCP_FILE);
+    if (chdir("/") == 0)
+    {
+        rmdir(scratch);
+    }
+
+    return (joined == options.nodes) ? 0 : 1;
+}
@@ -0,0 +1,301 @@
+/* C++ Includes */
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+/* Simulator Includes */
+#include "Chimera/chimera.hpp"
+#include "nrf24l01.hpp"
+#include "RF24Network.hpp"
+#include "SimMedium.hpp"
+
+using RF24Sim::Medium;
+using RF24Sim::Route;
+
+namespace Chimera
+{
+    uint32_t millis()
+    {
+        return static_cast<uint32_t>(Medium::now() / 1000);
+    }
+
+    uint32_t micros()
+    {
+        return static_cast<uint32_t>(Medium::now());
+    }
+
+    void delayMilliseconds(uint32_t ms)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+}
+
+namespace NRF24L
+{
+    NRF24L01::NRF24L01() : simPort(new RF24Sim::Port())
+    {
+        Medium::instance().attach(simPort);
+    }
+
+    NRF24L01::~NRF24L01()
+    {
+        Medium::instance().detach(simPort);
+        delete simPort;
+    }
+
+    bool NRF24L01::begin()
+    {
+        Medium::instance().setPowered(*simPort, true);
+        return true;
+    }
+
+    void NRF24L01::setChannel(uint8_t channel)
+    {
+        Medium::instance().setChannel(*simPort, channel);
+    }
+
+    uint8_t NRF24L01::getChannel()
+    {
+        return simPort->channel;
+    }
+
+    bool NRF24L01::setDataRate(DataRate)
+    {
+        //The airtime comes from the medium configuration instead
+        return true;
+    }
+
+    void NRF24L01::startListening()
+    {
+    }
+
+    void NRF24L01::stopListening()
+    {
+    }
+
+    void NRF24L01::powerDown()
+    {
+        Medium::instance().setPowered(*simPort, false);
+    }
+
+    void NRF24L01::powerUp()
+    {
+        Medium::instance().setPowered(*simPort, true);
+    }
+
+    bool NRF24L01::available()
+    {
+        return Medium::instance().pending(*simPort);
+    }
+
+    bool NRF24L01::rxFifoFull()
+    {
+        return false;
+    }
+
+    bool NRF24L01::testRPD()
+    {
+        return Medium::instance().strongSignal();
+    }
+
+    RF24Sim::Port &NRF24L01::port()
+    {
+        return *simPort;
+    }
+}
+
+namespace RF24Network
+{
+    static constexpr uint8_t HEADER_SIZE = sizeof(Header);
+    static constexpr uint8_t FIRST_ACKED_TYPE = 65;
+    static constexpr uint8_t FIRST_SYSTEM_TYPE = 128;
+
+    static_assert(HEADER_SIZE == 8, "The simulated header must match the 8 byte RF24Network header");
+
+    Header::Header(uint16_t to, uint8_t type) : from_node(0), to_node(to), id(0), type(type), reserved(0)
+    {
+    }
+
+    Network::Network(NRF24L::NRF24L01 &radio) : returnSysMsgs(false), networkFlags(0), routeTimeout(75), txTimeout(25), radio(radio), nodeAddress(DEFAULT_ADDRESS), nextId(0)
+    {
+        memset(frame_buffer, 0, sizeof(frame_buffer));
+    }
+
+    void Network::begin(uint16_t address)
+    {
+        nodeAddress = address;
+        userFrames.clear();
+        Medium::instance().setAddress(radio.port(), address);
+    }
+
+    uint8_t Network::update()
+    {
+        std::vector<uint8_t> bytes;
+        if (!Medium::instance().receive(radio.port(), bytes))
+        {
+            const uint16_t idle = Medium::instance().config().idleSleepUs;
+            if (idle)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(idle));
+            }
+            return 0;
+        }
+
+        memset(frame_buffer, 0, sizeof(frame_buffer));
+        memcpy(frame_buffer, bytes.data(), (bytes.size() < sizeof(frame_buffer)) ? bytes.size() : sizeof(frame_buffer));
+
+        Header header;
+        memcpy(&header, bytes.data(), HEADER_SIZE);
+        const uint8_t *const payload = bytes.data() + HEADER_SIZE;
+        const uint16_t length = static_cast<uint16_t>(bytes.size() - HEADER_SIZE);
+
+        switch (header.type)
+        {
+            case NETWORK_POLL:
+            {
+                //A reply to this node's own poll goes up to the mesh
+                if (nodeAddress == DEFAULT_ADDRESS)
+                {
+                    break;
+                }
+
+                //Answered by the network layer, carrying the number of children as a load hint
+                if (!(networkFlags & FLAG_NO_POLL))
+                {
+                    Header reply(header.from_node, NETWORK_POLL);
+                    reply.reserved = Medium::instance().childCount(nodeAddress);
+                    send(reply, nullptr, 0, Route::DIRECT, header.from_node);
+                }
+                return 0;
+            }
+
+            case NETWORK_REQ_ADDRESS:
+            {
+                //Passed on to the master with this node as the contact
+                if (nodeAddress)
+                {
+                    header.from_node = nodeAddress;
+                    header.to_node = 0;
+                    std::vector<uint8_t> forward(bytes);
+                    memcpy(forward.data(), &header, HEADER_SIZE);
+                    Medium::instance().transmit(radio.port(), forward.data(), forward.size(), Route::TREE, 0, false);
+                    return 0;
+                }
+                break;
+            }
+
+            case NETWORK_ADDR_RESPONSE:
+            {
+                //Handed on to the node that asked, which is still on the default address
+                if (nodeAddress != DEFAULT_ADDRESS)
+                {
+                    Header forward = header;
+                    forward.to_node = DEFAULT_ADDRESS;
+                    send(forward, payload, length, Route::DIRECT, DEFAULT_ADDRESS);
+                    return 0;
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        if (header.type < FIRST_SYSTEM_TYPE)
+        {
+            if (!(networkFlags & FLAG_HOLD_INCOMING))
+            {
+                userFrames.push_back(bytes);
+            }
+            return header.type;
+        }
+        return returnSysMsgs ? header.type : 0;
+    }
+
+    bool Network::available()
+    {
+        return !userFrames.empty();
+    }
+
+    uint16_t Network::peek(Header &header)
+    {
+        if (userFrames.empty())
+        {
+            return 0;
+        }
+        memcpy(&header, userFrames.front().data(), HEADER_SIZE);
+        return static_cast<uint16_t>(userFrames.front().size() - HEADER_SIZE);
+    }
+
+    void Network::peek(Header &header, void *message, uint16_t maxlen)
+    {
+        if (userFrames.empty())
+        {
+            return;
+        }
+
+        const std::vector<uint8_t> &frame = userFrames.front();
+        const uint16_t length = static_cast<uint16_t>(frame.size() - HEADER_SIZE);
+        memcpy(&header, frame.data(), HEADER_SIZE);
+        if (message)
+        {
+            memcpy(message, frame.data() + HEADER_SIZE, (length < maxlen) ? length : maxlen);
+        }
+    }
+
+    uint16_t Network::read(Header &header, void *message, uint16_t maxlen)
+    {
+        if (userFrames.empty())
+        {
+            return 0;
+        }
+
+        const std::vector<uint8_t> frame = userFrames.front();
+        userFrames.pop_front();
+
+        const uint16_t length = static_cast<uint16_t>(frame.size() - HEADER_SIZE);
+        const uint16_t copied = (length < maxlen) ? length : maxlen;
+        memcpy(&header, frame.data(), HEADER_SIZE);
+        if (message && copied)
+        {
+            memcpy(message, frame.data() + HEADER_SIZE, copied);
+        }
+        return copied;
+    }
+
+    bool Network::write(Header &header, const void *message, uint16_t len)
+    {
+        return send(header, message, len, Route::TREE, header.to_node);
+    }
+
+    bool Network::write(Header &header, const void *message, uint16_t len, uint16_t writeDirect)
+    {
+        return send(header, message, len, Route::DIRECT, writeDirect);
+    }
+
+    bool Network::multicast(Header &header, const void *message, uint16_t len, uint8_t level)
+    {
+        return send(header, message, len, Route::MULTICAST, level);
+    }
+
+    bool Network::send(Header &header, const void *message, uint16_t len, const Route route, const uint16_t target)
+    {
+        if (len > MAX_PAYLOAD_SIZE)
+        {
+            return false;
+        }
+
+        header.from_node = nodeAddress;
+        header.id = ++nextId;
+
+        std::vector<uint8_t> bytes(HEADER_SIZE + len);
+        memcpy(bytes.data(), &header, HEADER_SIZE);
+        if (message && len)
+        {
+            memcpy(bytes.data() + HEADER_SIZE, message, len);
+        }
+
+        const bool endToEnd = (header.type >= FIRST_ACKED_TYPE) && (header.type < FIRST_SYSTEM_TYPE);
+        return Medium::instance().transmit(radio.port(), bytes.data(), bytes.size(), route, target, endToEnd);
+    }
+}
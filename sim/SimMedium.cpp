@@ -0,0 +1,307 @@
+/* C++ Includes */
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+/* Simulator Includes */
+#include "RF24NetworkDefinitions.hpp"
+#include "SimMedium.hpp"
+
+namespace RF24Sim
+{
+    static uint16_t ancestor(const uint16_t address, const uint8_t level)
+    {
+        return address & ((1u << (3 * level)) - 1);
+    }
+
+    Medium &Medium::instance()
+    {
+        static Medium medium;
+        return medium;
+    }
+
+    Medium::Medium() : settings(DEFAULT_MEDIUM), stats(), airFree(0), randomState(DEFAULT_MEDIUM.seed)
+    {
+    }
+
+    void Medium::configure(const MediumConfig &config)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        settings = config;
+        randomState = config.seed ? config.seed : 1;
+    }
+
+    MediumConfig Medium::config() const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return settings;
+    }
+
+    MediumCounters Medium::counters() const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return stats;
+    }
+
+    void Medium::attach(Port *const port)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        port->address = RF24Network::DEFAULT_ADDRESS;
+        port->channel = 0;
+        port->powered = true;
+        ports.push_back(port);
+    }
+
+    void Medium::detach(Port *const port)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ports.erase(std::remove(ports.begin(), ports.end(), port), ports.end());
+    }
+
+    void Medium::setAddress(Port &port, const uint16_t address)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        port.address = address;
+    }
+
+    void Medium::setChannel(Port &port, const uint8_t channel)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        port.channel = channel;
+    }
+
+    void Medium::setPowered(Port &port, const bool powered)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        port.powered = powered;
+        if (!powered)
+        {
+            port.inbox.clear();
+        }
+    }
+
+    bool Medium::transmit(Port &from, const uint8_t *const bytes, const size_t length, const Route route, const uint16_t target, const bool endToEnd)
+    {
+        bool ok = false;
+        uint64_t sent = 0;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stats.transmissions++;
+
+            if (!from.powered)
+            {
+                return false;
+            }
+
+            const uint64_t start = std::max(now(), airFree);
+            const uint64_t hop = settings.airtimeUs + settings.hopLatencyUs;
+            sent = start + settings.airtimeUs;
+            airFree = sent;
+
+            if (route == Route::MULTICAST)
+            {
+                for (Port *port : ports)
+                {
+                    if ((port == &from) || !port->powered || (port->channel != from.channel) ||
+                        (port->address == RF24Network::DEFAULT_ADDRESS) || (level(port->address) != target))
+                    {
+                        continue;
+                    }
+
+                    if (chance(settings.lossPercent))
+                    {
+                        stats.lost++;
+                        continue;
+                    }
+                    deliver(*port, bytes, length, start + hop);
+                }
+                ok = true;
+            }
+            else if ((route == Route::DIRECT) || (target == RF24Network::DEFAULT_ADDRESS) || (from.address == RF24Network::DEFAULT_ADDRESS))
+            {
+                //Every radio still on the default address hears it, exactly as on real hardware
+                for (Port *port : ports)
+                {
+                    if ((port == &from) || !port->powered || (port->channel != from.channel) || (port->address != target))
+                    {
+                        continue;
+                    }
+
+                    if (chance(settings.lossPercent))
+                    {
+                        stats.lost++;
+                        continue;
+                    }
+                    deliver(*port, bytes, length, start + hop);
+                    ok = true;
+                }
+            }
+            else
+            {
+                std::vector<uint16_t> hops;
+                if (!path(from.address, target, hops))
+                {
+                    return false;
+                }
+
+                //Relays forward on the air too, so the whole path holds the channel
+                airFree = start + hops.size() * settings.airtimeUs;
+
+                size_t reached = 0;
+                Port *last = nullptr;
+                for (const uint16_t address : hops)
+                {
+                    last = find(from, address);
+                    if (!last)
+                    {
+                        stats.unroutable++;
+                        break;
+                    }
+                    if (chance(settings.lossPercent))
+                    {
+                        stats.lost++;
+                        break;
+                    }
+                    reached++;
+                }
+
+                if (reached == hops.size())
+                {
+                    deliver(*last, bytes, length, start + hops.size() * hop);
+                }
+                ok = endToEnd ? (reached == hops.size()) : (reached != 0);
+
+                //An end to end ack has to travel back up the path before the write returns
+                if (endToEnd && ok)
+                {
+                    sent = start + 2 * hops.size() * hop;
+                }
+            }
+        }
+
+        const uint64_t current = now();
+        if (sent > current)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(sent - current));
+        }
+        return ok;
+    }
+
+    bool Medium::receive(Port &port, std::vector<uint8_t> &bytes)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (port.inbox.empty() || (port.inbox.front().due > now()))
+        {
+            return false;
+        }
+
+        bytes.swap(port.inbox.front().bytes);
+        port.inbox.pop_front();
+        return true;
+    }
+
+    bool Medium::pending(Port &port)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return !port.inbox.empty() && (port.inbox.front().due <= now());
+    }
+
+    uint8_t Medium::childCount(const uint16_t address)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        const uint8_t depth = level(address);
+
+        uint8_t count = 0;
+        for (const Port *port : ports)
+        {
+            if ((port->address != RF24Network::DEFAULT_ADDRESS) && (level(port->address) == depth + 1) && (ancestor(port->address, depth) == address))
+            {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    bool Medium::strongSignal()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return chance(settings.rpdPercent);
+    }
+
+    uint64_t Medium::now()
+    {
+        static const auto origin = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    uint8_t Medium::level(const uint16_t address)
+    {
+        uint8_t depth = 0;
+        for (uint16_t remaining = address; remaining; remaining >>= 3)
+        {
+            depth++;
+        }
+        return depth;
+    }
+
+    bool Medium::chance(const uint8_t percent)
+    {
+        //xorshift32
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        return (randomState % 100) < percent;
+    }
+
+    bool Medium::path(const uint16_t from, const uint16_t to, std::vector<uint16_t> &hops)
+    {
+        if (from == to)
+        {
+            return false;
+        }
+
+        const uint8_t fromLevel = level(from);
+        const uint8_t toLevel = level(to);
+        uint8_t common = 0;
+        while ((common < fromLevel) && (common < toLevel) && (ancestor(from, common + 1) == ancestor(to, common + 1)))
+        {
+            common++;
+        }
+
+        //Up to the closest common ancestor, then down to the target
+        for (uint8_t depth = fromLevel; depth-- > common;)
+        {
+            hops.push_back(ancestor(from, depth));
+        }
+        for (uint8_t depth = common + 1; depth <= toLevel; depth++)
+        {
+            hops.push_back(ancestor(to, depth));
+        }
+        return true;
+    }
+
+    Port *Medium::find(const Port &from, const uint16_t address)
+    {
+        for (Port *port : ports)
+        {
+            if ((port->address == address) && port->powered && (port->channel == from.channel))
+            {
+                return port;
+            }
+        }
+        return nullptr;
+    }
+
+    void Medium::deliver(Port &to, const uint8_t *const bytes, const size_t length, const uint64_t due)
+    {
+        stats.delivered++;
+
+        //Frames over fewer hops can overtake ones already in flight
+        auto position = to.inbox.end();
+        while ((position != to.inbox.begin()) && ((position - 1)->due > due))
+        {
+            --position;
+        }
+        to.inbox.insert(position, Port::Arrival{ due, std::vector<uint8_t>(bytes, bytes + length) });
+    }
+}
@@ -0,0 +1,151 @@
+/********************************************************************************
+*   SimMedium.hpp
+*       The shared air between the virtual radios of the host simulator. Models
+*       per hop loss and latency, channel occupancy and the octal tree routing
+*       of RF24Network, for any number of virtual nodes in one process.
+*
+*   2019 | Brandon Braun | brandonbraun653@gmail.com
+********************************************************************************/
+#pragma once
+#ifndef RF24SIM_MEDIUM_HPP
+#define RF24SIM_MEDIUM_HPP
+
+/* C++ Headers */
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace RF24Sim
+{
+    struct MediumConfig
+    {
+        uint8_t lossPercent;    /**< Chance of a frame being lost on each hop */
+        uint16_t hopLatencyUs;  /**< Processing and forwarding delay added on each hop */
+        uint16_t airtimeUs;     /**< Time a frame occupies the air, including the auto-ack */
+        uint8_t rpdPercent;     /**< Chance of testRPD() reporting a signal above -64dBm */
+        uint16_t idleSleepUs;   /**< How long an update() that received nothing sleeps, so idle nodes don't spin */
+        uint32_t seed;          /**< Seeds the loss and signal draws */
+    };
+
+    /**
+    *   Defaults roughly matching a 1Mbps link with a few percent loss
+    */
+    constexpr MediumConfig DEFAULT_MEDIUM = { 2, 500, 400, 70, 100, 1 };
+
+    struct MediumCounters
+    {
+        uint64_t transmissions; /**< Frames handed to the medium */
+        uint64_t delivered;     /**< Copies that reached a radio */
+        uint64_t lost;          /**< Hops on which a frame was dropped */
+        uint64_t unroutable;    /**< Frames whose path had a node missing, asleep or on another channel */
+    };
+
+    enum class Route : uint8_t
+    {
+        TREE,       /**< Routed through the octal tree to the target address */
+        DIRECT,     /**< One hop to every radio using the target address */
+        MULTICAST   /**< One hop to every radio at the target level */
+    };
+
+    /**
+    *   One virtual radio's attachment to the medium
+    */
+    struct Port
+    {
+        struct Arrival
+        {
+            uint64_t due;   /**< Medium time at which the frame reaches the radio */
+            std::vector<uint8_t> bytes;
+        };
+
+        uint16_t address;   /**< Set by the network layer, the default address until it begins */
+        uint8_t channel;
+        bool powered;
+        std::deque<Arrival> inbox;
+    };
+
+    class Medium
+    {
+    public:
+        static Medium &instance();
+
+        void configure(const MediumConfig &config);
+        MediumConfig config() const;
+        MediumCounters counters() const;
+
+        void attach(Port *const port);
+        void detach(Port *const port);
+        void setAddress(Port &port, const uint16_t address);
+        void setChannel(Port &port, const uint8_t channel);
+        void setPowered(Port &port, const bool powered);
+
+        /**
+        *   Puts a frame on the air. Blocks for the frame's airtime, as the radio would.
+        *
+        *   @param[in]  from        The sending radio
+        *   @param[in]  bytes       Header followed by the payload
+        *   @param[in]  length      Length of bytes
+        *   @param[in]  route       How the target is interpreted
+        *   @param[in]  target      The destination address, or the level for a multicast
+        *   @param[in]  endToEnd    Report success only if every hop succeeded, as for network acked types
+        *   @return True if the first hop, or with endToEnd the whole path, succeeded. Always true for a multicast.
+        */
+        bool transmit(Port &from, const uint8_t *const bytes, const size_t length, const Route route, const uint16_t target, const bool endToEnd);
+
+        /**
+        *   Takes the oldest frame that has reached the radio
+        *
+        *   @return False if none is due yet
+        */
+        bool receive(Port &port, std::vector<uint8_t> &bytes);
+
+        bool pending(Port &port);
+
+        /**
+        *   @return The number of radios attached directly below `address`, used for the poll load hint
+        */
+        uint8_t childCount(const uint16_t address);
+
+        bool strongSignal();
+
+        /**
+        *   @return Microseconds since the simulator started
+        */
+        static uint64_t now();
+
+        static uint8_t level(const uint16_t address);
+
+    private:
+        Medium();
+
+        mutable std::mutex lock;
+        std::vector<Port *> ports;
+        MediumConfig settings;
+        MediumCounters stats;
+        uint64_t airFree;   /**< When the air is next free. All channels share it, which overstates contention slightly. */
+        uint32_t randomState;
+
+        /**
+        *   @return True if the next draw falls below percent. Call with the lock held.
+        */
+        bool chance(const uint8_t percent);
+
+        /**
+        *   Lists the radios a routed frame passes through, ending with the target
+        *
+        *   @return False if the target is the sender
+        */
+        static bool path(const uint16_t from, const uint16_t to, std::vector<uint16_t> &hops);
+
+        /**
+        *   @return The attached radio using address that can hear from, or nullptr. Call with the lock held.
+        */
+        Port *find(const Port &from, const uint16_t address);
+
+        void deliver(Port &to, const uint8_t *const bytes, const size_t length, const uint64_t due);
+    };
+}
+
+#endif /* RF24SIM_MEDIUM_HPP */
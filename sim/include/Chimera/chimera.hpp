@@ -0,0 +1,29 @@
+/********************************************************************************
+*   chimera.hpp
+*       Simulated Chimera timing functions for building the mesh on a host.
+*
+*   2019 | Brandon Braun | brandonbraun653@gmail.com
+********************************************************************************/
+#pragma once
+#ifndef RF24SIM_CHIMERA_HPP
+#define RF24SIM_CHIMERA_HPP
+
+/* C++ Headers */
+#include <cstdint>
+
+namespace Chimera
+{
+    /**
+    *   @return Milliseconds since the simulator started
+    */
+    uint32_t millis();
+
+    /**
+    *   @return Microseconds since the simulator started
+    */
+    uint32_t micros();
+
+    void delayMilliseconds(uint32_t ms);
+}
+
+#endif /* RF24SIM_CHIMERA_HPP */
@@ -0,0 +1,85 @@
+/********************************************************************************
+*   RF24Network.hpp
+*       Simulated RF24Network layer. Routing through the octal tree, poll replies,
+*       address request relaying and system message handling follow the real
+*       library, while frames travel through RF24Sim::Medium.
+*
+*   2019 | Brandon Braun | brandonbraun653@gmail.com
+********************************************************************************/
+#pragma once
+#ifndef RF24SIM_NETWORK_HPP
+#define RF24SIM_NETWORK_HPP
+
+/* C++ Headers */
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+/* Simulator Headers */
+#include "nrf24l01.hpp"
+#include "RF24NetworkDefinitions.hpp"
+
+namespace RF24Sim
+{
+    enum class Route : uint8_t;
+}
+
+namespace RF24Network
+{
+    struct Header
+    {
+        uint16_t from_node;
+        uint16_t to_node;
+        uint16_t id;
+        uint8_t type;
+        uint8_t reserved;
+
+        Header() = default;
+        Header(uint16_t to, uint8_t type = 0);
+    };
+
+    class Network
+    {
+    public:
+        Network(NRF24L::NRF24L01 &radio);
+
+        void begin(uint16_t address);
+
+        /**
+        *   Takes one frame off the simulated medium
+        *
+        *   @return The type of the frame, or 0 if none arrived or the network layer handled it
+        */
+        uint8_t update();
+
+        bool available();
+        uint16_t peek(Header &header);
+        void peek(Header &header, void *message, uint16_t maxlen);
+        uint16_t read(Header &header, void *message, uint16_t maxlen);
+        bool write(Header &header, const void *message, uint16_t len);
+
+        /**
+        *   Sends straight to the radio at `writeDirect`, whatever the header's destination
+        */
+        bool write(Header &header, const void *message, uint16_t len, uint16_t writeDirect);
+
+        bool multicast(Header &header, const void *message, uint16_t len, uint8_t level);
+
+        uint8_t frame_buffer[MAX_FRAME_SIZE];
+        bool returnSysMsgs;
+        uint8_t networkFlags;
+        uint16_t routeTimeout;
+        uint16_t txTimeout;
+
+    private:
+        NRF24L::NRF24L01 &radio;
+        uint16_t nodeAddress;
+        uint16_t nextId;
+        std::deque<std::vector<uint8_t>> userFrames;
+
+        bool send(Header &header, const void *message, uint16_t len, const RF24Sim::Route route, const uint16_t target);
+    };
+}
+
+#endif /* RF24SIM_NETWORK_HPP */
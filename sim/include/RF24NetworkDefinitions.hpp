@@ -0,0 +1,38 @@
+/********************************************************************************
+*   RF24NetworkDefinitions.hpp
+*       The RF24Network constants the mesh relies on, for the host simulator.
+*
+*   2019 | Brandon Braun | brandonbraun653@gmail.com
+********************************************************************************/
+#pragma once
+#ifndef RF24SIM_NETWORK_DEFINITIONS_HPP
+#define RF24SIM_NETWORK_DEFINITIONS_HPP
+
+/* C++ Headers */
+#include <cstdint>
+
+namespace RF24Network
+{
+    constexpr uint16_t DEFAULT_ADDRESS = 04444;
+    constexpr uint8_t MAX_FRAME_SIZE = 32;
+    constexpr uint16_t MAX_PAYLOAD_SIZE = 144;   /** Largest message the simulated network carries, as with fragmentation enabled */
+
+    /*------------------------------------------------
+    System Message Types
+    ------------------------------------------------*/
+    constexpr uint8_t NETWORK_ADDR_RESPONSE = 128;
+    constexpr uint8_t NETWORK_PING = 130;
+    constexpr uint8_t NETWORK_ACK = 193;
+    constexpr uint8_t NETWORK_POLL = 194;
+    constexpr uint8_t NETWORK_REQ_ADDRESS = 195;
+
+    /*------------------------------------------------
+    Network Flags
+    ------------------------------------------------*/
+    constexpr uint8_t FLAG_HOLD_INCOMING = 1;
+    constexpr uint8_t FLAG_BYPASS_HOLDS = 2;
+    constexpr uint8_t FLAG_FAST_FRAG = 4;
+    constexpr uint8_t FLAG_NO_POLL = 8;
+}
+
+#endif /* RF24SIM_NETWORK_DEFINITIONS_HPP */
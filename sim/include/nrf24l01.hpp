@@ -0,0 +1,72 @@
+/********************************************************************************
+*   nrf24l01.hpp
+*       Simulated nRF24L01 driver. Each instance is one virtual radio attached
+*       to the shared RF24Sim::Medium.
+*
+*   2019 | Brandon Braun | brandonbraun653@gmail.com
+********************************************************************************/
+#pragma once
+#ifndef RF24SIM_NRF24L01_HPP
+#define RF24SIM_NRF24L01_HPP
+
+/* C++ Headers */
+#include <cstdint>
+
+namespace RF24Sim
+{
+    struct Port;
+}
+
+namespace NRF24L
+{
+    enum class DataRate : uint8_t
+    {
+        DR_1MBPS,
+        DR_2MBPS,
+        DR_250KBPS
+    };
+
+    /**
+    *   Only the calls the mesh makes are provided. Frames are carried by RF24Sim::Medium rather than SPI.
+    */
+    class NRF24L01
+    {
+    public:
+        NRF24L01();
+        ~NRF24L01();
+
+        NRF24L01(const NRF24L01 &) = delete;
+        NRF24L01 &operator=(const NRF24L01 &) = delete;
+
+        bool begin();
+        void setChannel(uint8_t channel);
+        uint8_t getChannel();
+        bool setDataRate(DataRate speed);
+        void startListening();
+        void stopListening();
+        void powerDown();
+        void powerUp();
+
+        /**
+        *   @return True if a frame has reached this radio and not been taken by the network layer
+        */
+        bool available();
+
+        bool rxFifoFull();
+
+        /**
+        *   @return True with the medium's configured probability, standing in for a signal above -64dBm
+        */
+        bool testRPD();
+
+        /**
+        *   The radio's attachment to the simulated medium, used by the simulated network layer
+        */
+        RF24Sim::Port &port();
+
+    private:
+        RF24Sim::Port *simPort;
+    };
+}
+
+#endif /* RF24SIM_NRF24L01_HPP */